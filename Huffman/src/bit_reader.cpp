@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "bit_reader.h"
+
+//#define DEBUG_MODE
+
+
+/**
+ * Creates a reader of the stream that starts at the current offset of the file. The offset must be at the start of a
+ * 128 bit element.
+ *
+ * @param reader     The reader
+ * @param file       The file
+ * @param first_bit  The first bit of the stream in the first element (the bits before it are skipped)
+ */
+void openBitReader(BitReader *reader, FILE *file, uint32_t first_bit) {
+    // The buffer has room for the 0 element after the end of the file
+    reader->words = (uint64_t *) malloc(BIT_READER_BUFFER_SIZE + 2 * sizeof(uint64_t));
+    reader->word_index = 0;
+    reader->n_words = 0;
+    reader->accumulator = 0;
+    reader->n_bits = 0;
+    reader->file = file;
+
+    // The bits of the first element before the stream
+    while (first_bit > 0) {
+        uint32_t skip = first_bit < 64 ? first_bit : 64;
+
+        getBits(reader, skip);
+        first_bit -= skip;
+    }
+}
+
+
+/**
+ * Reads the next buffer of the file
+ *
+ * @param reader  The reader
+ */
+void refillBitReader(BitReader *reader) {
+    uint64_t n_words = BIT_READER_BUFFER_SIZE / sizeof(uint64_t);
+
+    reader->n_words = fread(reader->words, sizeof(reader->words[0]), n_words, reader->file);
+    reader->word_index = 0;
+
+    // The stream continues with 0 bits after the end of the file. The elements are always read whole
+    if (reader->n_words < n_words) {
+        uint64_t n_read = (reader->n_words + 1) & ~1ULL;
+
+        memset(reader->words + reader->n_words, 0, (n_read + 2 - reader->n_words) * sizeof(uint64_t));
+        reader->n_words = n_read + 2;
+    }
+}
+
+
+/**
+ * Frees the buffer of the reader
+ *
+ * @param reader  The reader
+ */
+void closeBitReader(BitReader *reader) {
+    free(reader->words);
+    reader->words = nullptr;
+}
@@ -0,0 +1,113 @@
+#ifndef BIT_READER_H
+#define BIT_READER_H
+
+#include <cstdio>
+
+#include "structs.h"
+
+/*
+ * The bit reader reads the bit stream of the compressed files (see bit_writer.h) from a file in large buffers. The bits
+ * are taken from a 64 bit accumulator and the accumulator is refilled with the next word of the stream (word w of the
+ * stream is stored to words[w ^ 1]). Reading past the end of the file gives 0 bits.
+ */
+
+#define BIT_READER_BUFFER_SIZE (256 * 1024)  // The size of the input buffer in bytes
+
+
+typedef struct bit_reader {
+    uint64_t accumulator = 0;   /// The next bits of the stream aligned to the MSB (the bits after them are 0)
+    uint32_t n_bits = 0;        /// The number of bits in the accumulator
+
+    uint64_t *words = nullptr;  /// The input buffer
+    uint64_t word_index = 0;    /// The index of the next word of the stream in the buffer
+    uint64_t n_words = 0;       /// The number of words read to the buffer
+
+    FILE *file = nullptr;       /// The file the stream is read from
+} BitReader;
+
+
+/**
+ * Creates a reader of the stream that starts at the current offset of the file. The offset must be at the start of a
+ * 128 bit element.
+ *
+ * @param reader     The reader
+ * @param file       The file
+ * @param first_bit  The first bit of the stream in the first element (the bits before it are skipped)
+ */
+void openBitReader(BitReader *reader, FILE *file, uint32_t first_bit);
+
+
+/**
+ * Reads the next buffer of the file
+ *
+ * @param reader  The reader
+ */
+void refillBitReader(BitReader *reader);
+
+
+/**
+ * Frees the buffer of the reader
+ *
+ * @param reader  The reader
+ */
+void closeBitReader(BitReader *reader);
+
+
+/**
+ * Reads up to 64 bits from the stream
+ *
+ * @param reader  The reader
+ * @param length  The number of bits (1 to 64)
+ * @return        The bits (right aligned)
+ */
+inline uint64_t getBits(BitReader *reader, uint32_t length) {
+    // The top length bits of the accumulator (the bits after the valid ones are 0)
+    uint64_t bits = reader->accumulator >> (64 - length);
+
+    if (length <= reader->n_bits) {
+        reader->accumulator = (reader->accumulator << 1) << (length - 1);
+        reader->n_bits -= length;
+
+        return bits;
+    }
+
+    // The rest of the bits are the first bits of the next word
+    if (reader->word_index == reader->n_words) {
+        refillBitReader(reader);
+    }
+
+    uint64_t word = reader->words[reader->word_index++ ^ 1];
+    uint32_t rest = length - reader->n_bits;
+
+    bits |= word >> (64 - rest);
+
+    reader->accumulator = (word << 1) << (rest - 1);
+    reader->n_bits = 64 - rest;
+
+    return bits;
+}
+
+
+/**
+ * Returns up to 64 bits of the stream without consuming them
+ *
+ * @param reader  The reader
+ * @param length  The number of bits (1 to 64)
+ * @return        The bits (right aligned)
+ */
+inline uint64_t peekBits(BitReader *reader, uint32_t length) {
+    if (length <= reader->n_bits) {
+        return reader->accumulator >> (64 - length);
+    }
+
+    // The rest of the bits are the first bits of the next word (the accumulator has fewer than 64 bits)
+    if (reader->word_index == reader->n_words) {
+        refillBitReader(reader);
+    }
+
+    uint64_t word = reader->words[reader->word_index ^ 1];
+
+    return (reader->accumulator | word >> reader->n_bits) >> (64 - length);
+}
+
+#endif
@@ -0,0 +1,435 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "bit_writer.h"
+#include "file_utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ENCODE_X86
+#include <immintrin.h>
+#endif
+
+//#define DEBUG_MODE
+
+
+/**
+ * Creates a writer that writes the stream to a file. The writer allocates its buffer.
+ *
+ * @param writer      The writer
+ * @param file        The file the stream is written to (at its current offset)
+ * @param block_bits  The number of bits of a block (a multiple of 128)
+ */
+void openBitWriter(BitWriter *writer, FILE *file, uint32_t block_bits) {
+    writer->block_words = block_bits / WORD_BITS;
+
+    // The buffer holds whole blocks, so only the last flush can end in the middle of a block
+    uint64_t n_blocks = BIT_WRITER_BUFFER_SIZE / (block_bits / 8);
+    writer->n_words = (n_blocks > 0 ? n_blocks : 1) * writer->block_words;
+    writer->words = (uint64_t *) malloc(writer->n_words * sizeof(uint64_t));
+
+    writer->accumulator = 0;
+    writer->n_bits = 0;
+    writer->word_index = 0;
+    writer->file = file;
+    writer->fd = -1;
+    writer->offset = 0;
+    writer->n_blocks = 0;
+}
+
+
+/**
+ * Creates a writer that writes the stream to an offset of a descriptor with pwrite. The descriptor can be shared by the
+ * writers of the sections of a file. The writer allocates its buffer.
+ *
+ * @param writer      The writer
+ * @param fd          The descriptor the stream is written to
+ * @param offset      The offset of the stream in the descriptor
+ * @param block_bits  The number of bits of a block (a multiple of 128)
+ */
+void openBitWriterAt(BitWriter *writer, int fd, uint64_t offset, uint32_t block_bits) {
+    openBitWriter(writer, nullptr, block_bits);
+
+    writer->fd = fd;
+    writer->offset = offset;
+}
+
+
+/**
+ * Creates a writer that writes the stream to a buffer of the caller. The blocks are single 128 bit elements.
+ *
+ * @param writer   The writer
+ * @param words    The buffer (big enough for the stream rounded up to 128 bits)
+ * @param n_words  The size of the buffer in words
+ */
+void attachBitWriter(BitWriter *writer, uint64_t *words, uint64_t n_words) {
+    writer->block_words = 2;
+    writer->n_words = n_words;
+    writer->words = words;
+
+    writer->accumulator = 0;
+    writer->n_bits = 0;
+    writer->word_index = 0;
+    writer->file = nullptr;
+    writer->fd = -1;
+    writer->n_blocks = 0;
+}
+
+
+/**
+ * Writes the full buffer of a file writer to the file
+ *
+ * @param writer  The writer
+ */
+void flushBitWriter(BitWriter *writer) {
+    if (writer->fd >= 0) {
+        // The whole buffer is written with one pwrite at the offset of the writer
+        writeFileAt(writer->fd, writer->words, writer->word_index * sizeof(writer->words[0]), writer->offset);
+        writer->offset += writer->word_index * sizeof(writer->words[0]);
+
+    } else if (writer->file != nullptr) {
+        fwrite(writer->words, sizeof(writer->words[0]), writer->word_index, writer->file);
+
+    } else {
+        // The buffer of the caller holds the whole stream
+        return;
+    }
+
+    writer->n_blocks += writer->word_index / writer->block_words;
+    writer->word_index = 0;
+}
+
+
+/**
+ * Writes the pending bits and pads the stream with 0 bits up to the end of the block. A file writer writes the rest of
+ * its buffer to the file and frees it.
+ *
+ * @param writer  The writer
+ * @return        The number of padding bits
+ */
+uint32_t closeBitWriter(BitWriter *writer) {
+    uint32_t n_padding_bits = 0;
+
+    if (writer->n_bits > 0) {
+        writer->words[writer->word_index++ ^ 1] = writer->accumulator;
+        n_padding_bits += WORD_BITS - writer->n_bits;
+
+        writer->accumulator = 0;
+        writer->n_bits = 0;
+    }
+
+    // A block that was started is completed with 0 words
+    while (writer->word_index % writer->block_words != 0) {
+        writer->words[writer->word_index++ ^ 1] = 0;
+        n_padding_bits += WORD_BITS;
+    }
+
+#ifdef DEBUG_MODE
+    std::cout << "Bit writer closed with " << n_padding_bits << " padding bits" << std::endl;
+#endif
+
+    if (writer->file != nullptr || writer->fd >= 0) {
+        flushBitWriter(writer);
+
+        free(writer->words);
+        writer->words = nullptr;
+    }
+
+    return n_padding_bits;
+}
+
+
+/**
+ * Starts the stream of a new writer at a bit of its first 128 bit element (CONTIGUOUS_STREAM). The bits before it belong
+ * to the previous section of the stream and are left 0.
+ *
+ * @param writer     The writer (nothing appended yet)
+ * @param first_bit  The first bit of the stream in the element (less than 128)
+ */
+void offsetBitWriter(BitWriter *writer, uint32_t first_bit) {
+    writer->word_index = first_bit / WORD_BITS;
+    writer->n_bits = first_bit % WORD_BITS;
+    writer->accumulator = 0;
+
+    // The first word belongs to the previous section
+    if (writer->word_index == 1) {
+        writer->words[0 ^ 1] = 0;
+    }
+}
+
+
+/**
+ * Writes the complete 128 bit elements of the stream and returns the last incomplete element instead of padding it
+ * (CONTIGUOUS_STREAM). The element is shared with the next section of the stream and is merged by writeStreamTails. A
+ * file writer writes the rest of its buffer to the file and frees it.
+ *
+ * @param writer  The writer
+ * @param tail    The last incomplete element as stored in the file (2 words, 0 if the stream ends with an element)
+ */
+void closeBitWriterTail(BitWriter *writer, uint64_t *tail) {
+    tail[0] = 0;
+    tail[1] = 0;
+
+    if (writer->word_index % 2 == 1) {
+        // The first word of the element is complete, the pending bits are the second one
+        tail[1] = writer->words[(writer->word_index - 1) ^ 1];
+        tail[0] = writer->accumulator;
+        writer->word_index--;
+
+    } else if (writer->n_bits > 0) {
+        tail[1] = writer->accumulator;
+    }
+
+    writer->accumulator = 0;
+    writer->n_bits = 0;
+
+    if (writer->file != nullptr || writer->fd >= 0) {
+        flushBitWriter(writer);
+
+        free(writer->words);
+        writer->words = nullptr;
+    }
+}
+
+
+/**
+ * Creates the pair codes of a huffman table (PAIR_ENCODING). The pair of the characters a, b is (a << 8) | b.
+ *
+ * @param huffman     The huffman struct with the symbols
+ * @param pair_codes  The pair codes (PAIR_CODES_SIZE elements)
+ */
+void buildPairCodes(const ASCIIHuffman *huffman, uint32_t *pair_codes) {
+    // Only the symbols that fit a pair code are needed
+    uint32_t codes[256];
+
+    for (int i = 0; i < 256; ++i) {
+        const Symbol &symbol = huffman->symbols[i];
+        codes[i] = symbol.symbol_length <= PAIR_CODE_MAX_LENGTH ? (uint32_t) symbol.symbol.lower().lower() : 0;
+    }
+
+    for (int a = 0; a < 256; ++a) {
+        uint8_t length_a = huffman->symbols[a].symbol_length;
+
+        for (int b = 0; b < 256; ++b) {
+            uint32_t length = length_a + huffman->symbols[b].symbol_length;
+
+            pair_codes[(a << 8) | b] = 0;
+
+            if (length <= PAIR_CODE_MAX_LENGTH) {
+                uint32_t code = (codes[a] << huffman->symbols[b].symbol_length) | codes[b];
+                pair_codes[(a << 8) | b] = (code << 5) | length;
+            }
+        }
+    }
+}
+
+
+/**
+ * Packs the symbols of a huffman table for putBytesVector. The entry of a character is (code << 8) | length.
+ *
+ * @param huffman       The huffman struct with the symbols
+ * @param vector_codes  The packed symbols (256 elements)
+ * @return              True if every symbol fits VECTOR_CODE_MAX_LENGTH bits and the table can be vector encoded
+ */
+bool buildVectorCodes(const ASCIIHuffman *huffman, uint32_t *vector_codes) {
+    for (int i = 0; i < 256; ++i) {
+        const Symbol &symbol = huffman->symbols[i];
+
+        if (symbol.symbol_length > VECTOR_CODE_MAX_LENGTH) {
+            return false;
+        }
+
+        vector_codes[i] = ((uint32_t) symbol.symbol.lower().lower() << 8) | symbol.symbol_length;
+    }
+
+    return true;
+}
+
+
+/**
+ * The portable kernel encodes nothing and leaves the whole buffer to putBytes, so its parameters are unnamed
+ */
+static uint64_t putBytesScalar(BitWriter *, const uint8_t *, uint64_t, const uint32_t *) {
+    return 0;
+}
+
+
+#ifdef ENCODE_X86
+
+/**
+ * Encodes a group of 8 characters to up to 128 bits. The entries of the characters are gathered from the packed table
+ * and the symbols are merged in register as a prefix tree: every even symbol is shifted by the length of the odd one and
+ * ORed with it, then the same is done with the pairs. The two quads (up to 64 bits each) are aligned to the MSB of the
+ * group in the scalar registers.
+ *
+ * @param data          The 8 characters
+ * @param vector_codes  The packed symbols (buildVectorCodes)
+ * @param high          The first 64 bits of the group
+ * @param low           The next 64 bits of the group
+ * @return              The number of bits of the group
+ */
+__attribute__((target("avx2")))
+static inline uint32_t encodeGroupAVX2(const uint8_t *data, const uint32_t *vector_codes, uint64_t *high,
+                                       uint64_t *low) {
+    __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) data));
+    __m256i entries = _mm256_i32gather_epi32((const int *) vector_codes, index, 4);
+
+    __m256i lengths = _mm256_and_si256(entries, _mm256_set1_epi32(0xFF));
+    __m256i codes = _mm256_srli_epi32(entries, 8);
+
+    // Pairs: the even symbol of every 64 bit lane is shifted over the odd one
+    __m256i odd_lengths = _mm256_srli_epi64(lengths, 32);
+    __m256i even_codes = _mm256_and_si256(codes, _mm256_set1_epi64x(0xFFFFFFFF));
+    __m256i pairs = _mm256_or_si256(_mm256_sllv_epi64(even_codes, odd_lengths), _mm256_srli_epi64(codes, 32));
+    __m256i pair_lengths = _mm256_and_si256(_mm256_add_epi64(lengths, odd_lengths), _mm256_set1_epi64x(0xFF));
+
+    // Quads: the even pair of every 128 bit half is shifted over the odd one
+    __m256i odd_pair_lengths = _mm256_srli_si256(pair_lengths, 8);
+    __m256i quads = _mm256_or_si256(_mm256_sllv_epi64(pairs, odd_pair_lengths), _mm256_srli_si256(pairs, 8));
+    __m256i quad_lengths = _mm256_add_epi64(pair_lengths, odd_pair_lengths);
+
+    uint64_t first = (uint64_t) _mm256_extract_epi64(quads, 0);
+    uint64_t second = (uint64_t) _mm256_extract_epi64(quads, 2);
+    uint32_t first_length = (uint32_t) _mm256_extract_epi64(quad_lengths, 0);
+    uint32_t n_bits = first_length + (uint32_t) _mm256_extract_epi64(quad_lengths, 2);
+
+    /*
+     * The quads are aligned to the MSB of the group. Four 16 bit symbols make a quad of exactly 64 bits: a first quad
+     * of 64 bits is the whole first word and a second quad of 64 bits after it has no bits in the first word
+     * (n_bits == 128). Shifting a 64 bit number by 64 is undefined, so both cases are handled without the shift.
+     */
+    *high = first_length == WORD_BITS ? first : (first << 1) << (WORD_BITS - 1 - first_length);
+
+    if (n_bits <= WORD_BITS) {
+        *high |= second << (WORD_BITS - n_bits);
+        *low = 0;
+
+    } else {
+        *high |= n_bits == 2 * WORD_BITS ? 0 : second >> (n_bits - WORD_BITS);
+        *low = second << (2 * WORD_BITS - n_bits);
+    }
+
+    return n_bits;
+}
+
+
+/**
+ * Appends the bits of a group (encodeGroupAVX2) to the stream. The group is merged to the accumulator directly, so it
+ * takes one branch per completed word instead of one putBits per 64 bits.
+ *
+ * @param writer  The writer
+ * @param high    The first 64 bits of the group
+ * @param low     The next 64 bits of the group (0 after the end of the group)
+ * @param n_bits  The number of bits of the group (up to 128)
+ */
+static inline void putGroup(BitWriter *writer, uint64_t high, uint64_t low, uint32_t n_bits) {
+    uint32_t shift = writer->n_bits;
+    uint32_t total = shift + n_bits;
+
+    // The bits of the group that follow the first word (the double shifts clear them if the accumulator is empty)
+    uint64_t next = ((high << 1) << (WORD_BITS - 1 - shift)) | low >> shift;
+    uint64_t last = (low << 1) << (WORD_BITS - 1 - shift);
+
+    writer->accumulator |= high >> shift;
+
+    if (total < WORD_BITS) {
+        writer->n_bits = total;
+        return;
+    }
+
+    writer->words[writer->word_index++ ^ 1] = writer->accumulator;
+    writer->accumulator = next;
+    total -= WORD_BITS;
+
+    if (total >= WORD_BITS) {
+        if (writer->word_index == writer->n_words) {
+            flushBitWriter(writer);
+        }
+
+        writer->words[writer->word_index++ ^ 1] = next;
+        writer->accumulator = last;
+        total -= WORD_BITS;
+    }
+
+    writer->n_bits = total;
+
+    if (writer->word_index == writer->n_words) {
+        flushBitWriter(writer);
+    }
+}
+
+
+/**
+ * AVX2 kernel. Encodes 16 characters per step as two independent groups of 8 so the gathers of the second group
+ * overlap the shifts of the first one.
+ */
+__attribute__((target("avx2")))
+static uint64_t putBytesAVX2(BitWriter *writer, const uint8_t *data, uint64_t length, const uint32_t *vector_codes) {
+    uint64_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        uint64_t high[2], low[2];
+
+        uint32_t first = encodeGroupAVX2(data + i, vector_codes, &high[0], &low[0]);
+        uint32_t second = encodeGroupAVX2(data + i + 8, vector_codes, &high[1], &low[1]);
+
+        putGroup(writer, high[0], low[0], first);
+        putGroup(writer, high[1], low[1], second);
+    }
+
+    return i;
+}
+
+#endif
+
+
+typedef uint64_t (*EncodeKernel)(BitWriter *writer, const uint8_t *data, uint64_t length, const uint32_t *vector_codes);
+
+typedef struct encode_kernel_entry {
+    EncodeKernel kernel;  /// The kernel function
+    const char *name;     /// The name printed by encodeKernelName
+} EncodeKernelEntry;
+
+
+/**
+ * Picks the encoding kernel the cpu supports. This is done once when the program starts.
+ *
+ * @return The selected kernel
+ */
+static EncodeKernelEntry selectEncodeKernel() {
+#ifdef ENCODE_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return {putBytesAVX2, "avx2"};
+    }
+#endif
+
+    return {putBytesScalar, "scalar"};
+}
+
+static const EncodeKernelEntry encode_kernel = selectEncodeKernel();
+
+
+/**
+ * Returns the name of the encoding kernel selected for this cpu
+ *
+ * @return The kernel name (scalar or avx2)
+ */
+const char *encodeKernelName() {
+    return encode_kernel.name;
+}
+
+
+/**
+ * Appends the symbols of the longest prefix of a buffer the vector kernel of the cpu encodes. The rest of the buffer
+ * (the whole buffer with the scalar kernel) is left to putBytes.
+ *
+ * @param writer        The writer
+ * @param data          The characters
+ * @param length        The number of characters
+ * @param vector_codes  The packed symbols (buildVectorCodes)
+ * @return              The number of characters encoded
+ */
+uint64_t putBytesVector(BitWriter *writer, const uint8_t *data, uint64_t length, const uint32_t *vector_codes) {
+    return encode_kernel.kernel(writer, data, length, vector_codes);
+}
@@ -0,0 +1,290 @@
+#ifndef BIT_WRITER_H
+#define BIT_WRITER_H
+
+#include <cstdio>
+
+#include "structs.h"
+
+/*
+ * The bit writer appends the symbols of the compressors to a bit stream. The bits are collected in a 64 bit accumulator
+ * and every full accumulator is stored to the output buffer with a single store. The stream has the layout of the
+ * compressed files: 128 bit elements (uint128_t) that are filled from the MSB to the LSB and grouped in blocks. An
+ * uint128_t is stored as a little endian number, so the first 64 bits of an element are the second word of the element
+ * in memory and word w of the stream is stored to words[w ^ 1].
+ *
+ * A writer either flushes its buffer to a file every BIT_WRITER_BUFFER_SIZE bytes (openBitWriter), flushes it to an
+ * offset of a descriptor with pwrite (openBitWriterAt) or writes the whole stream to a buffer of the caller
+ * (attachBitWriter). The first two are file writers.
+ */
+
+#define BIT_WRITER_BUFFER_SIZE (256 * 1024)  // The size of the output buffer of a file writer in bytes
+#define WORD_BITS 64                         // The number of bits of a word of the stream
+
+/*
+ * The pair codes (PAIR_ENCODING) are the concatenated symbols of every pair of characters, so the compressors append two
+ * characters with one lookup. A pair code is stored as (code << 5) | length and only the pairs up to
+ * PAIR_CODE_MAX_LENGTH bits have one (the table is 256KB and stays in the L2 cache). The other pairs are 0 and their
+ * characters are appended one by one.
+ */
+#define PAIR_CODE_MAX_LENGTH 27
+#define PAIR_CODES_SIZE (256 * 256)
+
+/*
+ * The vector kernel (putBytesVector) encodes 8 characters at a time to at most 128 bits, so it only encodes the tables
+ * whose symbols fit VECTOR_CODE_MAX_LENGTH bits. The kernel is selected at startup from the features of the cpu (AVX2 or
+ * none) and the other tables and cpus use the scalar writer.
+ */
+#define VECTOR_CODE_MAX_LENGTH 16
+
+#define ENCODE_BUFFER_SIZE (64 * 1024)  // The number of characters the compressors read and encode at a time
+
+
+typedef struct bit_writer {
+    uint64_t accumulator = 0;   /// The pending bits aligned to the MSB
+    uint32_t n_bits = 0;        /// The number of pending bits (less than WORD_BITS)
+
+    uint64_t *words = nullptr;  /// The output buffer
+    uint64_t word_index = 0;    /// The index of the next word of the stream in the buffer
+    uint64_t n_words = 0;       /// The size of the buffer in words (a multiple of block_words)
+    uint32_t block_words = 2;   /// The number of words of a block
+
+    FILE *file = nullptr;       /// The file the buffer is flushed to (nullptr if the buffer holds the whole stream)
+    int fd = -1;                /// The descriptor the buffer is written to with pwrite (-1 if there is none)
+    uint64_t offset = 0;        /// The offset of the next flush in the descriptor
+    uint64_t n_blocks = 0;      /// The number of blocks flushed to the file
+
+} BitWriter;
+
+
+/**
+ * Creates a writer that writes the stream to a file. The writer allocates its buffer.
+ *
+ * @param writer      The writer
+ * @param file        The file the stream is written to (at its current offset)
+ * @param block_bits  The number of bits of a block (a multiple of 128)
+ */
+void openBitWriter(BitWriter *writer, FILE *file, uint32_t block_bits);
+
+
+/**
+ * Creates a writer that writes the stream to an offset of a descriptor with pwrite. The descriptor can be shared by the
+ * writers of the sections of a file. The writer allocates its buffer.
+ *
+ * @param writer      The writer
+ * @param fd          The descriptor the stream is written to
+ * @param offset      The offset of the stream in the descriptor
+ * @param block_bits  The number of bits of a block (a multiple of 128)
+ */
+void openBitWriterAt(BitWriter *writer, int fd, uint64_t offset, uint32_t block_bits);
+
+
+/**
+ * Creates a writer that writes the stream to a buffer of the caller. The blocks are single 128 bit elements.
+ *
+ * @param writer   The writer
+ * @param words    The buffer (big enough for the stream rounded up to 128 bits)
+ * @param n_words  The size of the buffer in words
+ */
+void attachBitWriter(BitWriter *writer, uint64_t *words, uint64_t n_words);
+
+
+/**
+ * Writes the full buffer of a file writer to the file
+ *
+ * @param writer  The writer
+ */
+void flushBitWriter(BitWriter *writer);
+
+
+/**
+ * Writes the pending bits and pads the stream with 0 bits up to the end of the block. A file writer writes the rest of
+ * its buffer to the file and frees it.
+ *
+ * @param writer  The writer
+ * @return        The number of padding bits
+ */
+uint32_t closeBitWriter(BitWriter *writer);
+
+
+/**
+ * Starts the stream of a new writer at a bit of its first 128 bit element (CONTIGUOUS_STREAM). The bits before it belong
+ * to the previous section of the stream and are left 0.
+ *
+ * @param writer     The writer (nothing appended yet)
+ * @param first_bit  The first bit of the stream in the element (less than 128)
+ */
+void offsetBitWriter(BitWriter *writer, uint32_t first_bit);
+
+
+/**
+ * Writes the complete 128 bit elements of the stream and returns the last incomplete element instead of padding it
+ * (CONTIGUOUS_STREAM). The element is shared with the next section of the stream and is merged by writeStreamTails. A
+ * file writer writes the rest of its buffer to the file and frees it.
+ *
+ * @param writer  The writer
+ * @param tail    The last incomplete element as stored in the file (2 words, 0 if the stream ends with an element)
+ */
+void closeBitWriterTail(BitWriter *writer, uint64_t *tail);
+
+
+/**
+ * Appends up to 64 bits to the stream. The bits above the length must be 0.
+ *
+ * @param writer  The writer
+ * @param code    The bits (right aligned)
+ * @param length  The number of bits (1 to 64)
+ */
+inline void putBits(BitWriter *writer, uint64_t code, uint32_t length) {
+    uint32_t free_bits = WORD_BITS - writer->n_bits;
+
+    if (length < free_bits) {
+        writer->accumulator |= code << (free_bits - length);
+        writer->n_bits += length;
+        return;
+    }
+
+    // The accumulator is full. The rest of the code starts the next word (the double shift clears it if there is none)
+    uint32_t rest = length - free_bits;
+
+    writer->words[writer->word_index++ ^ 1] = writer->accumulator | code >> rest;
+    writer->accumulator = (code << 1) << (WORD_BITS - 1 - rest);
+    writer->n_bits = rest;
+
+    if (writer->word_index == writer->n_words) {
+        flushBitWriter(writer);
+    }
+}
+
+
+/**
+ * Creates the pair codes of a huffman table (PAIR_ENCODING). The pair of the characters a, b is (a << 8) | b.
+ *
+ * @param huffman     The huffman struct with the symbols
+ * @param pair_codes  The pair codes (PAIR_CODES_SIZE elements)
+ */
+void buildPairCodes(const ASCIIHuffman *huffman, uint32_t *pair_codes);
+
+
+/**
+ * Packs the symbols of a huffman table for putBytesVector. The entry of a character is (code << 8) | length.
+ *
+ * @param huffman       The huffman struct with the symbols
+ * @param vector_codes  The packed symbols (256 elements)
+ * @return              True if every symbol fits VECTOR_CODE_MAX_LENGTH bits and the table can be vector encoded
+ */
+bool buildVectorCodes(const ASCIIHuffman *huffman, uint32_t *vector_codes);
+
+
+/**
+ * Returns the name of the encoding kernel selected for this cpu
+ *
+ * @return The kernel name (scalar or avx2)
+ */
+const char *encodeKernelName();
+
+
+/**
+ * Appends the symbols of the longest prefix of a buffer the vector kernel of the cpu encodes. The rest of the buffer
+ * (the whole buffer with the scalar kernel) is left to putBytes.
+ *
+ * @param writer        The writer
+ * @param data          The characters
+ * @param length        The number of characters
+ * @param vector_codes  The packed symbols (buildVectorCodes)
+ * @return              The number of characters encoded
+ */
+uint64_t putBytesVector(BitWriter *writer, const uint8_t *data, uint64_t length, const uint32_t *vector_codes);
+
+
+/**
+ * Appends a symbol to the stream
+ *
+ * @param writer  The writer
+ * @param code    The symbol (the first bit is the MSB of its length bit number)
+ * @param length  The length of the symbol in bits (up to the width of the code word)
+ */
+template <typename CodeWord>
+inline void putCode(BitWriter *writer, CodeWord code, uint8_t length) {
+    putBits(writer, (uint64_t) code, length);
+}
+
+inline void putCode(BitWriter *writer, const uint256_t &code, uint8_t length) {
+    // Longer symbols are written 64 bits at a time starting from their MSBs
+    while (length > WORD_BITS) {
+        length -= WORD_BITS;
+        putBits(writer, (code >> length).lower().lower(), WORD_BITS);
+    }
+
+    uint64_t part = code.lower().lower();
+
+    if (length < WORD_BITS) {
+        part &= (1ULL << length) - 1;
+    }
+
+    putBits(writer, part, length);
+}
+
+
+/**
+ * Appends the symbols of two characters to the stream with their pair code if they have one
+ *
+ * @param writer   The writer
+ * @param data     The two characters
+ * @param symbols  The symbols of the characters (256 elements)
+ * @param pair     The pair code of the characters (0 if they have none)
+ */
+template <typename CodeWord>
+inline void putPair(BitWriter *writer, const uint8_t *data, const SymbolT<CodeWord> *symbols, uint32_t pair) {
+    if (pair != 0) {
+        putBits(writer, pair >> 5, pair & 31);
+
+    } else {
+        putCode(writer, symbols[data[0]].symbol, symbols[data[0]].symbol_length);
+        putCode(writer, symbols[data[1]].symbol, symbols[data[1]].symbol_length);
+    }
+}
+
+
+/**
+ * Appends the symbols of a buffer of characters to the stream. If there are vector codes the vector kernel encodes
+ * the buffer first. If there are pair codes the characters left are appended four at a time: two pair codes (up to
+ * 2 x PAIR_CODE_MAX_LENGTH bits) are concatenated and appended with one write.
+ *
+ * @param writer        The writer
+ * @param data          The characters
+ * @param length        The number of characters
+ * @param symbols       The symbols of the characters (256 elements)
+ * @param pair_codes    The pair codes of the symbols (buildPairCodes) or nullptr
+ * @param vector_codes  The packed symbols (buildVectorCodes) or nullptr
+ */
+template <typename CodeWord>
+inline void putBytes(BitWriter *writer, const uint8_t *data, uint64_t length, const SymbolT<CodeWord> *symbols,
+                     const uint32_t *pair_codes, const uint32_t *vector_codes) {
+    uint64_t i = 0;
+
+    if (vector_codes != nullptr) {
+        i = putBytesVector(writer, data, length, vector_codes);
+    }
+
+    if (pair_codes != nullptr) {
+        for (; i + 3 < length; i += 4) {
+            uint32_t first = pair_codes[(data[i] << 8) | data[i + 1]];
+            uint32_t second = pair_codes[(data[i + 2] << 8) | data[i + 3]];
+
+            if (first != 0 && second != 0) {
+                uint32_t second_length = second & 31;
+                putBits(writer, (uint64_t) (first >> 5) << second_length | (second >> 5), (first & 31) + second_length);
+
+            } else {
+                putPair(writer, data + i, symbols, first);
+                putPair(writer, data + i + 2, symbols, second);
+            }
+        }
+    }
+
+    for (; i < length; ++i) {
+        putCode(writer, symbols[data[i]].symbol, symbols[data[i]].symbol_length);
+    }
+}
+
+#endif
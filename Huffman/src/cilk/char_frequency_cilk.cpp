@@ -1,146 +1,174 @@
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
 
 #include "char_frequency_cilk.h"
 #include "../file_utils.h"
+#include "../histogram.h"
+#include "../sparse.h"
 
-//#define DEBUG_MODE
-
+#define MIN_CHUNK_SIZE (64 * 1024)         // The smallest chunk counted by a cilk_for iteration (64KB)
+#define MAX_CHUNK_SIZE (16 * 1024 * 1024)  // The largest chunk counted by a cilk_for iteration (16MB)
+#define CHUNKS_PER_WORKER 8                // The number of chunks every worker gets on average
 
-typedef struct job_args {
-    uint64_t *freq_arr = nullptr;
-    std::string filename;
+//#define DEBUG_MODE
 
-    uint64_t start_byte = 0;  // inclusive
-    uint64_t end_byte = 0;  // exclusive
 
-} JobArgs;
+/**
+ * The frequencies of every section of the file. This is the type of the reducer hyperobject, every worker that steals
+ * work gets its own view and the runtime merges the views when the strands join.
+ */
+typedef struct section_frequencies {
+    uint64_t freq[CILK_JOBS][256];
+} SectionFrequencies;
 
 
 /**
- * Counts the character frequency of every ascii char of the file being compressed.
+ * The identity of the reducer. Every new view starts with all the frequencies set to zero.
  *
- * @param file           The file to count the frequencies
- * @param frequency_arr  The frequency array of the characters
- * @param start_byte     The byte (inclusive, measuring from 0) from where to start counting in the file
- * @param end_byte       The byte (exclusive, measuring from 0) to where to stop counting in the file
+ * @param view  The view to initialise
  */
-void charFrequency(FILE *file, uint64_t *frequency_arr, uint64_t start_byte, uint64_t end_byte) {
-
-    uint8_t c;  // The character read from the file
-
-    fseek(file, (long)start_byte, SEEK_SET);  // Jump to the beginning of the section to count
-
-    uint64_t file_len = end_byte - start_byte;  // The number of bytes to read from the file
-
-    unsigned long int scan_size = file_len;
-
-    // Read from the file byte by byte
-    for (uint64_t i = 0; i < scan_size; ++i) {
-        fread(&c, sizeof(c), 1, file);
-
-        // For every half char read update the frequency
-        frequency_arr[c]++;
-    }
+void zeroFrequencies(void *view) {
+    memset(view, 0, sizeof(SectionFrequencies));
 }
 
 
 /**
- * Runnable function that calculates the characters frequency of a part of a file. The file is simultaneously handled
- * by multiple threads each having it's own handler. Every thread reads and counts a different part of the file, from
- * start_byte to end byte
+ * The reduce operation of the reducer. The right view is added to the left one.
  *
- * @param args FreqArgs struct containing the arguments of the function
- * @return
+ * @param left   The view that holds the result
+ * @param right  The view that is merged to the left one
  */
-void frequencyRunnable(JobArgs *arguments) {
-    // Each thread creates it's own file handler
-    FILE *file = openBinaryFile(arguments->filename, "rb");
-
-    // Count the frequencies of the part of the file assigned
-    charFrequency(file, arguments->freq_arr, arguments->start_byte, arguments->end_byte);
+void addFrequencies(void *left, void *right) {
+    auto *left_view = (SectionFrequencies *) left;
+    auto *right_view = (SectionFrequencies *) right;
 
-    fclose(file);  // close the file
+    for (int i = 0; i < CILK_JOBS; ++i) {
+        for (int j = 0; j < 256; ++j) {
+            left_view->freq[i][j] += right_view->freq[i][j];
+        }
+    }
 }
 
 
 /**
- * Divides the frequency calculation work between threads and then creates the threads to actually calculate the
- * frequencies
+ * Calculates the frequencies of the characters of the file. The file is divided in CILK_JOBS sections (the sections
+ * compressFile uses) and every section is divided in chunks. The number of chunks depends on the number of cilk
+ * workers, not on CILK_JOBS, so all the workers get work and the runtime balances it with work stealing.
+ *
+ * Every chunk is read with pread from a single shared descriptor and counted in the view of a SectionFrequencies
+ * reducer. The views are merged by the runtime, so no per job array has to be accumulated by the serial code.
  *
  * @param filename The input file name (to be compressed)
  * @param huffman  The huffman struct
  */
 void calculateFrequency(const std::string& filename, ASCIIHuffman *huffman) {
-    FILE *file = openBinaryFile(filename, "rb");
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        std::cout << "File not found..." << std::endl;
+        exit(-1);
+    }
 
     // Get the file length
-    fseek(file, 0, SEEK_END);  // Jump to the end of the file
-    uint64_t file_len = ftell(file);  // Get the current byte offset in the file
+    uint64_t file_len = fileSize(filename);
 
-    rewind(file);  // Jump back to the beginning of the file
+#ifdef SPARSE_FILES
+    // The sections and the chunks divide the data extents of the file. The holes are not read
+    SparseMap map;
+    readSparseMap(filename, &map);
 
-    // The frequencies array is initialised.
-    for (auto & frequency : huffman->frequencies) {
-        for (int j = 0; j < 256; ++j) {
-            frequency[j] = 0;
-        }
-    }
+    std::cout << map.n_extents << " data extents, " << file_len - map.data_size << " bytes in holes skipped" << std::endl;
 
-    JobArgs job_args[CILK_JOBS]; // The struct array containing the arguments for every thread
+    file_len = map.data_size;
+#endif
 
-    uint64_t bytes_per_job;  // The number of bytes every thread will process
-    uint64_t last_bytes_per_job;  // The number of bytes the first thread will process
+    uint64_t bytes_per_section;  // The number of bytes every section has
+    uint64_t last_bytes_per_section;  // The number of bytes the last section has
 
-    // Determine the bytes each thread will process
+    // Determine the bytes of each section
     if (file_len % CILK_JOBS == 0) {
-        bytes_per_job = last_bytes_per_job = file_len / CILK_JOBS;
+        bytes_per_section = last_bytes_per_section = file_len / CILK_JOBS;
 
     } else {
-        bytes_per_job = file_len / CILK_JOBS;
-        last_bytes_per_job = bytes_per_job + file_len % CILK_JOBS;
+        bytes_per_section = file_len / CILK_JOBS;
+        last_bytes_per_section = bytes_per_section + file_len % CILK_JOBS;
     }
 
-    for (int i = 0; i < CILK_JOBS; ++i) {
-        // Create the thread's arguments
-        job_args[i].freq_arr = huffman->frequencies[i];
-        job_args[i].filename = filename;
+    // The chunk size is chosen so every worker counts CHUNKS_PER_WORKER chunks on average
+    unsigned int n_workers = __cilkrts_get_nworkers();
+    uint64_t chunk_size = file_len / ((uint64_t) n_workers * CHUNKS_PER_WORKER);
 
-        if (i == CILK_JOBS - 1) {
-            job_args[i].start_byte = i * bytes_per_job;
-            job_args[i].end_byte = i * bytes_per_job + last_bytes_per_job;
-
-        } else {
-            job_args[i].start_byte = i * bytes_per_job;
-            job_args[i].end_byte = i * bytes_per_job + bytes_per_job;
-        }
+    if (chunk_size < MIN_CHUNK_SIZE) {
+        chunk_size = MIN_CHUNK_SIZE;
 
-        // Cilk spawn a new thread
-        cilk_spawn frequencyRunnable(&job_args[i]);
+    } else if (chunk_size > MAX_CHUNK_SIZE) {
+        chunk_size = MAX_CHUNK_SIZE;
+    }
 
-        #ifdef DEBUG_MODE
-                cout << "Thread: " << i << " calculating frequencies..." << endl;
-        #else
-                if(i == 0) {
-                    std::cout << CILK_JOBS << " cilk jobs created and counting frequencies..." << std::endl;
-                }
-        #endif
+    // Round the chunk size to whole pages
+    chunk_size = (chunk_size + HIST_ALIGNMENT - 1) / HIST_ALIGNMENT * HIST_ALIGNMENT;
 
+    // Every worker has its own read buffer
+    auto **buffers = (uint8_t **) malloc(n_workers * sizeof(uint8_t *));
+    for (unsigned int i = 0; i < n_workers; ++i) {
+        buffers[i] = (uint8_t *) aligned_alloc(HIST_ALIGNMENT, chunk_size);
     }
 
-    // Sync all the workers
-    cilk_sync;
+    std::cout << n_workers << " cilk workers counting frequencies in chunks of " << chunk_size << " bytes..."
+              << std::endl;
+
+    SectionFrequencies cilk_reducer(zeroFrequencies, addFrequencies) frequencies;
+    zeroFrequencies(&frequencies);
+
+    cilk_for (int section = 0; section < CILK_JOBS; ++section) {
+        uint64_t start_byte = section * bytes_per_section;
+        uint64_t end_byte = start_byte + (section == CILK_JOBS - 1 ? last_bytes_per_section : bytes_per_section);
+
+        uint64_t n_chunks = (end_byte - start_byte + chunk_size - 1) / chunk_size;
+
+        cilk_for (uint64_t chunk = 0; chunk < n_chunks; ++chunk) {
+            uint64_t offset = start_byte + chunk * chunk_size;
+            uint64_t length = end_byte - offset < chunk_size ? end_byte - offset : chunk_size;
+
+            // The buffer of the worker running this iteration
+            uint8_t *buffer = buffers[__cilkrts_get_worker_number()];
+
+#ifdef SPARSE_FILES
+            ssize_t n_read = preadData(fd, &map, buffer, length, offset);
+#else
+            ssize_t n_read = pread(fd, buffer, length, (off_t) offset);
+#endif
+
+            if (n_read > 0) {
+                countBytes(buffer, (uint64_t) n_read, frequencies.freq[section]);
+            }
+        }
+    }
 
     #ifdef DEBUG_MODE
-        cout << "Accumulating..." << endl;
+        std::cout << "Accumulating..." << std::endl;
     #endif
 
-    // Accumulate all the frequencies
-    for (auto &frequency: huffman->frequencies) {
+    // Store the merged view and accumulate the frequencies of all the sections
+    for (int i = 0; i < CILK_JOBS; ++i) {
         for (int j = 0; j < 256; ++j) {
-            huffman->charFreq[j] += frequency[j];
+            huffman->frequencies[i][j] = frequencies.freq[i][j];
+            huffman->charFreq[j] += frequencies.freq[i][j];
         }
     }
 
-    // Close the file
-    fclose(file);
-}
\ No newline at end of file
+    for (unsigned int i = 0; i < n_workers; ++i) {
+        free(buffers[i]);
+    }
+    free(buffers);
+
+#ifdef SPARSE_FILES
+    freeSparseMap(&map);
+#endif
+
+    close(fd);
+}
@@ -4,8 +4,8 @@
 #include "../structs.h"
 
 /**
- * Divides the frequency calculation work between threads and then creates the threads to actually calculate the
- * frequencies
+ * Calculates the frequencies of every section of the file with a cilk_for over chunks of the file. The per section
+ * frequencies are collected in a reducer hyperobject and stored in huffman->frequencies, their sum in huffman->charFreq
  *
  * @param filename The input file name (to be compressed)
  * @param huffman  The huffman struct
@@ -1,10 +1,18 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
 #include <cilk/cilk.h>
 
 #include "compress_cilk.h"
 #include "../file_utils.h"
+#include "../huffman.h"
+#include "../fused.h"
+#include "../sparse.h"
+#include "../bit_writer.h"
+#include "../lanes.h"
+#include "../stream.h"
 
 #define CHAR_BUFF_SIZE 2048  // The size of the write buffer
 #define SYM_BUFF_SIZE 128   // The size of the read buffer single element
@@ -13,77 +21,10 @@
 
 using namespace std;
 
-/**
- * A symbol is inserted in the buffer. If the buffer is full after the insertion the buffer is written to the compressed
- * file.
- *
- * @param buffer         The buffer that is written to the file. The buffer is 128 x n array
- * @param buff_index     The index to the buffer
- * @param write_index    The index of the bit for the 128 bit buffer element
- * @param compressed     The file compressed pointer
- * @param symbol_length  The length of the symbol to insert to the buffer
- * @param symbol         The symbol to be inserted in the buffer
- * @param bufferSize     The size of the buffer
- */
-void insertToBuffer(uint128_t *buffer, int *buff_index, uint8_t *write_index, uint32_t *nBlocks, FILE *compressed,
-                    uint8_t symbol_length, uint256_t symbol, uint16_t bufferSize) {
-
-    buffer[*buff_index] = buffer[*buff_index] << symbol_length;  // make room for the new symbol
-
-    // Keep only the 128 LSBs of the symbol and append it to the buffer
-    buffer[*buff_index] += symbol.lower();
-
-    if (*write_index + 1 - symbol_length == 0) {  // if the symbol fits exactly...
-        *write_index = SYM_BUFF_SIZE - 1;  // ... reset the write_index ...
-        *buff_index += 1;  // ... and increment the buffer index
-
-        // If the buffer is full...
-        if (*buff_index == bufferSize){
-            //... write the buffer to the file...
-            fwrite(buffer, sizeof(buffer[0]), bufferSize, compressed);
-
-            *nBlocks += 1;  // increment the number of blocks
-            *buff_index = 0;  // ... and reset the index
-
-            // reset the buffer
-            for (int i = 0; i < bufferSize; ++i) {
-                buffer[i] = 0;
-            }
-        }
-
-    } else {  // else if there is still space in the symbol
-        *write_index -= symbol_length;  // Update the write index
-    }
-}
-
-
-/**
- * The worst case regarding symbol length is 32 bytes. This is a rare and very specific case. To conserve as much
- * space as possible we store the symbols using the minimum number of bytes required. After every symbol the length
- * of it is written. Before the huffman table the number of bytes per symbols is also written in the file
- *
- * @param file     The compressed file pointer
- * @param huffman  The huffman struct containing all the symbols
- */
-void writeHuffmanToFile(FILE *file, ASCIIHuffman *huffman, uint16_t *meta_data_size) {
-
-    // Write the symbols with their lengths in the file
-    for (Symbol &symbol : huffman->symbols) {
-        // Write the huffman table to the beginning of the file
-        fwrite(&symbol.symbol, sizeof(huffman->symbols[0].symbol), 1, file);
-        *meta_data_size = *meta_data_size + sizeof(huffman->symbols[0].symbol);
-
-        // Write the length of the symbol to the file
-        fwrite(&symbol.symbol_length, sizeof(symbol.symbol_length), 1, file);
-        *meta_data_size = *meta_data_size + sizeof(symbol.symbol_length);
-    }
-}
-
-
 typedef struct compress_job_args{
     int t_id;                 /// The id of the thread
     char const *file;         /// The file to be compressed
-    char const *output_file;  /// The compressed file
+    int fd;                   /// The descriptor of the compressed file (shared by all the jobs)
     ASCIIHuffman *huffman;    /// The huffman struct containing the symbols
 
     uint64_t start_byte;      /// The thread reads from this byte (inclusive)
@@ -92,25 +33,32 @@ typedef struct compress_job_args{
     uint64_t compressed_start_byte;    /// The thread starts writing from this byte (inclusive)
     uint64_t compressed_end_byte;      /// The thread stops writing up to this byte (exclusive)
 
-    uint32_t *number_of_blocks;        /// The number of blocks that the thread writes to the file
-    uint32_t *number_of_padding;       /// The number of padding bits that the thread writes to the end of the section
+    uint32_t *number_of_blocks;        /// The planned number of blocks of the section (checked by the thread)
+    uint32_t *number_of_padding;       /// The planned padding bits of the section (checked by the thread)
 
     uint16_t buffer_size;              /// The size of the buffer in bytes
+    bool stored;                       /// The characters are copied as they are instead of encoded
+
+#ifdef SPARSE_FILES
+    const SparseMap *sparse_map;       /// The data extents of the input file (the bytes are data offsets)
+#endif
+
+#ifdef CONTIGUOUS_STREAM
+    StreamSection *section;            /// The place of the section in the stream (compressed_start_byte is its first element)
+#endif
 } CompressJobArgs;
 
 
 /**
- * The thread function that compresses the file. Every thread has to compress a part of the file
- * @param args  The arguments of the thread (CompressArgs)
- * @return status code
+ * Compresses the section of a thread with the symbols narrowed to a code word type
+ *
+ * @param arguments  The arguments of the thread
  */
-int compressFileJob(CompressJobArgs *arguments) {
+template <typename CodeWord>
+void compressSection(CompressJobArgs *arguments) {
 
     // Extract some of the arguments for cleaner looking code
     ASCIIHuffman *huffman = arguments->huffman;
-    uint32_t *n_blocks = arguments->number_of_blocks;
-    uint32_t *n_padding_bits = arguments->number_of_padding;
-    uint16_t  buffer_size = arguments->buffer_size;
 
     #ifdef DEBUG_MODE
         cout << "Thread: " << arguments->t_id << " compressing from byte: " << arguments->start_byte << " to byte: " << arguments->end_byte << endl;
@@ -119,98 +67,191 @@ int compressFileJob(CompressJobArgs *arguments) {
     // Open the file to be compressed
     FILE *file = openBinaryFile(arguments->file, "rb");
 
-    // Open the compressed file
-    FILE *compressed = openBinaryFile(arguments->output_file, "rb+");
-
     // Seek the start of the file to the starting byte
+#ifdef SPARSE_FILES
+    // Seek to the extent of the starting byte. The file is seeked again every time an extent ends
+    uint64_t extent_end = seekData(file, arguments->sparse_map, arguments->start_byte);
+#else
     fseek(file, (long int)arguments->start_byte, SEEK_SET);
-
-    // Seek the start of the compressed file to the starting byte
-    fseek(compressed, (long int)arguments->compressed_start_byte, SEEK_SET);
+#endif
 
     // Start compressing the file
 
-    // The buffer holds the data to be written to the file. Once the buffer is full the data are written to the file
-    // and the buffer is overwritten with the next part of data. The process repeats until the end
-    auto *buffer = (uint128_t *)calloc(buffer_size, sizeof(uint128_t));
+    // The symbols are appended to the blocks of the section by the bit writer. The writer writes its full buffer to the
+    // section with one pwrite on the shared descriptor of the compressed file
+    BitWriter writer;
+#ifdef CONTIGUOUS_STREAM
+    // The section starts at its exact bit in its first element. The elements are the blocks of the writer
+    openBitWriterAt(&writer, arguments->fd, arguments->compressed_start_byte, SYM_BUFF_SIZE);
+    offsetBitWriter(&writer, arguments->section->start_bit % SYM_BUFF_SIZE);
+#else
+    openBitWriterAt(&writer, arguments->fd, arguments->compressed_start_byte, arguments->buffer_size * SYM_BUFF_SIZE);
+#endif
+
+    // The symbols with the narrowest code word that fits the longest symbol
+    SymbolT<CodeWord> symbols[256];
+    narrowSymbols(huffman, symbols);
 
-    // Start reading from the file and converting chars to symbols
-    uint8_t c;  // The character read from the file
+    uint64_t byte_count = arguments->end_byte - arguments->start_byte;  // The size of the file to be compressed
 
-    uint256_t symbol = 0;  // The symbol along with the symbol length of every char
-    uint8_t symbol_length = 0;  // The symbol length
-    uint8_t write_index = SYM_BUFF_SIZE - 1;  // The index of the start point of the symbol in the buffer
+    uint32_t *pair_codes = nullptr;
 
-    // The index to the buffer
-    int buff_index = 0;
+#ifdef PAIR_ENCODING
+    // Two characters are encoded with one lookup whenever their symbols fit a pair code
+    pair_codes = (uint32_t *) malloc(PAIR_CODES_SIZE * sizeof(uint32_t));
+    buildPairCodes(huffman, pair_codes);
+#endif
 
-    uint64_t byte_count = arguments->end_byte - arguments->start_byte;  // The size of the file to be compressed
+#ifndef INTERLEAVED_LANES
+    // The vector kernel encodes the buffers when every symbol fits VECTOR_CODE_MAX_LENGTH bits
+    uint32_t packed_codes[256];
+    const uint32_t *vector_codes = buildVectorCodes(huffman, packed_codes) ? packed_codes : nullptr;
+#endif
 
-    // Read from the file byte by byte
-    for (uint64_t i = 0; i < byte_count; ++i) {
-        fread(&c, sizeof(c), 1, file);  // Read byte from the file
+#ifdef INTERLEAVED_LANES
+    // The characters are dealt to the lanes and every full frame is appended to the stream
+    LaneEncoder lanes;
+    openLaneEncoder(&lanes, huffman);
+#endif
 
-        symbol = huffman->symbols[c].symbol;  // The symbol of the read char
-        symbol_length = huffman->symbols[c].symbol_length;  // The number of bits of the symbol
+    // Read the section in buffers of ENCODE_BUFFER_SIZE characters and convert the characters to symbols
+    auto *data = (uint8_t *) malloc(ENCODE_BUFFER_SIZE);
 
-        if (write_index + 1 - symbol_length < 0) {  // If the buffer can't fit the symbol
-            // The buffer can fit write_index + 1 bits of the symbol
+    for (uint64_t i = 0; i < byte_count;) {
+        uint64_t length = byte_count - i < ENCODE_BUFFER_SIZE ? byte_count - i : ENCODE_BUFFER_SIZE;
 
-            uint256_t mask = (1 << (symbol_length - write_index - 1)) - 1;
+#ifdef SPARSE_FILES
+        // A buffer never crosses the end of an extent
+        if (arguments->start_byte + i == extent_end) {
+            extent_end = seekData(file, arguments->sparse_map, arguments->start_byte + i);
+        }
 
-            // Split the symbol
-            uint256_t remaining_symbol = symbol & mask;  // keep the remaining symbol
-            uint8_t remaining_length = symbol_length - write_index - 1;
+        length = extent_end - arguments->start_byte - i < length ? extent_end - arguments->start_byte - i : length;
+#endif
+        length = fread(data, sizeof(data[0]), length, file);
 
-            symbol = symbol & ~mask;  // The part of the symbol that fits
-            symbol = symbol >> remaining_length;  // realign the symbol
-            symbol_length = write_index + 1;  // The length of the symbol that fits
+        if (length == 0) {
+            cout << "Could not read " << arguments->file << endl;
+            exit(-1);
+        }
 
-            // append the symbol to the buffer and if the buffer is full write to the file
-            insertToBuffer(buffer, &buff_index, &write_index, n_blocks, compressed, symbol_length, symbol, buffer_size);
+#ifdef INTERLEAVED_LANES
+        putLaneBytes(&lanes, &writer, data, length, symbols);
+#else
+        putBytes(&writer, data, length, symbols, pair_codes, vector_codes);
+#endif
 
-            // append the remaining symbol to the buffer and if the buffer is full write to the file
-            insertToBuffer(buffer, &buff_index, &write_index, n_blocks, compressed, remaining_length, remaining_symbol,
-                           buffer_size);
+        i += length;
+    }
 
-        } else {  // else if the symbol fits in the buffer
+    free(data);
+    free(pair_codes);
 
-            // append to the buffer and if the buffer is full write to the file
-            insertToBuffer(buffer, &buff_index, &write_index, n_blocks, compressed, symbol_length, symbol, buffer_size);
-        }
+#ifdef INTERLEAVED_LANES
+    // The last frame of the lanes
+    closeLaneEncoder(&lanes, &writer);
+#endif
+
+#ifdef CONTIGUOUS_STREAM
+    // The last incomplete element is shared with the next section and is merged by writeStreamTails
+    closeBitWriterTail(&writer, arguments->section->tail);
+#else
+    // The last block of the section is padded with 0 bits. The section must end where it was planned
+    uint32_t *n_blocks = arguments->number_of_blocks;
+    uint32_t *n_padding_bits = arguments->number_of_padding;
+    uint32_t padding = closeBitWriter(&writer);
+
+    if (padding != *n_padding_bits || writer.n_blocks != *n_blocks) {
+        cout << "Job " << arguments->t_id << " wrote " << writer.n_blocks << " blocks and " << padding
+             << " padding bits instead of the planned " << *n_blocks << " and " << *n_padding_bits << endl;
+        exit(-1);
     }
 
-    // The final buffer may not be full. In that case the rest of the block bits will be 0 and will be counted as padding
+#ifdef DEBUG_MODE
+    cout << "Thread: " << arguments->t_id << " wrote " << *n_blocks << " blocks and " << *n_padding_bits
+         << " padding bits" << endl;
+#endif
+#endif
 
-    // if the buffer index is not 0 or the write index is not 7 the last buffer was not full
-    if (buff_index != 0 || write_index != SYM_BUFF_SIZE - 1) {
+    // close the file
+    fclose(file);
+}
 
-        // Update the number of padding bits. Every buffer element is SYM_BUFF_SIZE bits
-        *n_padding_bits += SYM_BUFF_SIZE * (buffer_size - buff_index - 1);
 
-        // zero the remaining bits in the buffer[buff_index]
-        if (write_index != SYM_BUFF_SIZE - 1) {
+/**
+ * Copies the characters of the section of a thread to the compressed file as they are (STORED_SECTIONS). The section is
+ * padded with 0 bytes to the end of its last block.
+ *
+ * @param arguments  The arguments of the thread
+ */
+void storeSection(CompressJobArgs *arguments) {
+    // Open the file to be compressed
+    FILE *file = openBinaryFile(arguments->file, "rb");
 
-            // Align the last SYM_BUFF_SIZE bits
-            buffer[buff_index] = buffer[buff_index] << (write_index + 1);
+#ifdef SPARSE_FILES
+    // Seek to the extent of the starting byte. The file is seeked again every time an extent ends
+    uint64_t extent_end = seekData(file, arguments->sparse_map, arguments->start_byte);
+#else
+    fseek(file, (long int)arguments->start_byte, SEEK_SET);
+#endif
 
-            *n_padding_bits += write_index + 1;  // add the final padding bits
+    uint64_t byte_count = arguments->end_byte - arguments->start_byte;  // The size of the section
+    uint64_t offset = arguments->compressed_start_byte;  // The offset of the next write
+
+    // Read the section in buffers of ENCODE_BUFFER_SIZE characters and write them to the section of the thread
+    auto *data = (uint8_t *) malloc(ENCODE_BUFFER_SIZE);
+
+    for (uint64_t i = 0; i < byte_count;) {
+        uint64_t length = byte_count - i < ENCODE_BUFFER_SIZE ? byte_count - i : ENCODE_BUFFER_SIZE;
+
+#ifdef SPARSE_FILES
+        // A buffer never crosses the end of an extent
+        if (arguments->start_byte + i == extent_end) {
+            extent_end = seekData(file, arguments->sparse_map, arguments->start_byte + i);
         }
 
-        // write the buffer to the file
-        fwrite(buffer, sizeof(buffer[0]), buffer_size, compressed);
+        length = extent_end - arguments->start_byte - i < length ? extent_end - arguments->start_byte - i : length;
+#endif
+        length = fread(data, sizeof(data[0]), length, file);
+
+        if (length == 0) {
+            cout << "Could not read " << arguments->file << endl;
+            exit(-1);
+        }
 
-        *n_blocks += 1;  // Update the number of blocks
+        writeFileAt(arguments->fd, data, length, offset);
+
+        offset += length;
+        i += length;
     }
 
-    #ifdef DEBUG_MODE
-        cout << "Thread: " << arguments->t_id << " wrote " << *n_blocks << " blocks and " << *n_padding_bits << " padding bits" << endl;
-    #endif
+    // The padding of the last block (less than a block)
+    memset(data, 0, arguments->compressed_end_byte - offset);
+    writeFileAt(arguments->fd, data, arguments->compressed_end_byte - offset, offset);
+
+#ifdef DEBUG_MODE
+    cout << "Thread: " << arguments->t_id << " stored " << byte_count << " characters" << endl;
+#endif
 
-    // close the files and free the memory
+    free(data);
     fclose(file);
-    fclose(compressed);
-    free(buffer);
+}
+
+
+/**
+ * The thread function that compresses the file. Every thread has to compress a part of the file
+ * @param args  The arguments of the thread (CompressArgs)
+ * @return status code
+ */
+int compressFileJob(CompressJobArgs *arguments) {
+    if (arguments->stored) {
+        storeSection(arguments);
+        return 0;
+    }
+
+    dispatchCodeWord(arguments->huffman, [&](auto code_word) {
+        compressSection<decltype(code_word)>(arguments);
+    });
 
     return 0;
 }
@@ -219,23 +260,30 @@ int compressFileJob(CompressJobArgs *arguments) {
 /**
  * Takes the file to be compressed reads the bits and creates a new compressed file. The compressed file has the
  * following format:
- *      Byte 0         The number of sections in the file (uint8_t)  (In this example 3)
- *      Byte 1:4       The number of the padding bits added to the end of the first section (uint32_t)
- *      Byte 5:8       The number of the padding bits added to the end of the second section (uint32_t)
- *      Byte 9:12      The number of the padding bits added to the end of the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 13:16     The number of blocks in the first section (uint32_t)
- *      Byte 17:20     The number of blocks in the second section (uint32_t)
- *      Byte 21:24     The number of blocks in the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 25:26     The block size used to group data (uint16_t)
- *      Byte 27:8474   The huffman table used to compress the file. After every 256 bit symbol the number of bits used
- *                     by the symbol are written as well as an 8 bit number. The size of the table is 256 x (256 + 8) bits
- *      Byte 8475:end  The compressed data
+ *
+ *      The fields follow each other in this order, n is the number of sections. The tables have a variable size, so the
+ *      offset of the data depends on their kinds:
+ *
+ *      uint8_t        The number of sections n
+ *      uint64_t[n]    The number of characters of every section
+ *      uint32_t[n]    The number of the padding bits added to the end of every section
+ *      uint32_t[n]    The number of blocks of every section
+ *                     (CONTIGUOUS_STREAM) Instead of the padding bits and the blocks, the number of bits of every
+ *                     section (uint64_t[n]). The sections are back to back in one stream padded to a whole block (see
+ *                     stream.h)
+ *      uint8_t[n]     (STORED_SECTIONS) Whether every section is stored
+ *      uint16_t       The block size used to group data
+ *      table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by the
+ *                     symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES), the id of a
+ *                     shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h. There are no
+ *                     tables if every section is stored
+ *      tables         (SECTION_TABLES) For every section a flag (uint8_t) followed by the table of the section if the
+ *                     flag is 1
+ *      data           The compressed data of the sections one after the other
+ *                     (INTERLEAVED_LANES) The data of every section is a sequence of lane frames (see lanes.h)
+ *                     (STORED_SECTIONS) The data of a stored section is its characters padded with 0 bytes to a whole
+ *                     block
+ *      extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  * @param file       The original file
  * @param filename   The filename of the compressed file
@@ -244,10 +292,27 @@ int compressFileJob(CompressJobArgs *arguments) {
  */
 void compressFile(const string& filename, const string& compressed_filename, ASCIIHuffman *huffman, uint16_t block_size) {
 
-    // Create the new file
-    FILE *compressed = openBinaryFile(compressed_filename, "wb");
+    // Create the new file (the shared elements of the sections are read back with CONTIGUOUS_STREAM)
+    FILE *compressed = openBinaryFile(compressed_filename, "wb+");
+
+#ifdef SPARSE_FILES
+    SparseMap map;
+    readSparseMap(filename, &map);
+#endif
+
+    uint32_t meta_data_size = 0;  // The size of the metadata in bytes
 
-    uint16_t meta_data_size = 0;  // The size of the metadata in bytes
+    // The table of every section
+    ASCIIHuffman *section_tables[CILK_JOBS];
+
+    for (int i = 0; i < CILK_JOBS; ++i) {
+#ifdef SECTION_TABLES
+        // The section gets its own table if it pays for itself
+        section_tables[i] = chooseSectionTable(huffman, huffman->frequencies[i]);
+#else
+        section_tables[i] = huffman;
+#endif
+    }
 
     CompressJobArgs args[CILK_JOBS];  // The arguments for the threads
 
@@ -256,54 +321,127 @@ void compressFile(const string& filename, const string& compressed_filename, ASC
     fwrite(&n_sections, sizeof(n_sections), 1, compressed);  // Write the number of sections to the file
     meta_data_size += sizeof(n_sections);  // Update the meta data size
 
+    uint8_t stored[CILK_JOBS] = {0};  // 1 if the characters of the section are stored as they are
+
     // STEP 2 - Write the number of characters of each section and init the args
     for (int i = 0; i < CILK_JOBS; ++i) {
         args[i].t_id = i;  // Set the thread id
 
         args[i].file = filename.c_str();  // The name of the file to be compressed
-        args[i].output_file = compressed_filename.c_str();  // The name of the compressed file
 
-        args[i].huffman = huffman;  // The huffman struct containing the symbols
+        args[i].huffman = section_tables[i];  // The huffman struct containing the symbols of the section
+#ifdef SPARSE_FILES
+        args[i].sparse_map = &map;  // The frequencies count only the data extents so the sections are data offsets
+#endif
 
         args[i].start_byte = 0;
         args[i].end_byte = 0;
         args[i].compressed_start_byte = 0;
         args[i].compressed_end_byte = 0;
+        args[i].stored = false;
 
         for (int j = 0; j < 256; ++j) {
             // Find the number of bytes each thread has to compress
             args[i].end_byte += huffman->frequencies[i][j];
+        }
 
-            // find the number of compressed bits that the thread has to write
-            args[i].compressed_end_byte += huffman->frequencies[i][j] * huffman->symbols[j].symbol_length;
+#ifdef STORED_SECTIONS
+        // The section is stored if its symbols (and its own table) would not make it smaller
+        uint64_t table_bits = section_tables[i] != huffman ? 8 * (uint64_t) huffmanTableSize(section_tables[i]) : 0;
+        stored[i] = storedStream(huffman->frequencies[i], section_tables[i], table_bits) ? 1 : 0;
+        args[i].stored = stored[i] == 1;
+
+        // A stored section needs no table
+        if (args[i].stored && section_tables[i] != huffman) {
+            free(section_tables[i]);
+            section_tables[i] = huffman;
+            args[i].huffman = huffman;
         }
+#endif
+
+        // find the exact number of compressed bits that the thread has to write
+        args[i].compressed_end_byte = stored[i] == 1 ? 8 * args[i].end_byte
+                                                     : streamBits(huffman->frequencies[i], section_tables[i]);
 
         fwrite(&args[i].end_byte, sizeof(args[i].end_byte), 1, compressed);  // Write the number of bytes to the file
         meta_data_size += sizeof(args[i].end_byte);  // Update the meta data size
     }
 
-    // STEP 3 - Write the number of padding bits of each section (updated in the end)
-    uint32_t section_padding[CILK_JOBS] = {0};  // The number of padding bits of each section (initially 0)
+    uint32_t section_padding[CILK_JOBS] = {0};  // The number of padding bits of each section
+    uint32_t n_blocks[CILK_JOBS] = {0};  // The number of blocks of each section
+
+#ifdef CONTIGUOUS_STREAM
+    // STEP 3 - Write the number of bits of each section. The bits are exact, so the sections are placed back to back
+    StreamSection sections[CILK_JOBS];
+
+    for (int i = 0; i < CILK_JOBS; ++i) {
+        sections[i].n_bits = args[i].compressed_end_byte;
+        fwrite(&sections[i].n_bits, sizeof(sections[i].n_bits), 1, compressed);
+        meta_data_size += sizeof(sections[i].n_bits);  // Update the meta data size
+    }
+
+    uint64_t stream_bits = placeStreamSections(sections, CILK_JOBS);
+#else
+    // The sections are planned from their exact number of bits, so the header is written once
+    for (int i = 0; i < CILK_JOBS; ++i) {
+        section_padding[i] = streamPadding(args[i].compressed_end_byte, block_size);
+        n_blocks[i] = (uint32_t) streamBlocks(args[i].compressed_end_byte, block_size);
+    }
+
+    // STEP 3 - Write the number of padding bits of each section
     fwrite(&section_padding, sizeof(section_padding[0]), CILK_JOBS, compressed);  // Write the padding bits to the file
     meta_data_size += sizeof(section_padding[0]) * CILK_JOBS;  // Update the meta data size
 
-    // STEP 4 - Write the number of blocks of each section (updated in the end)
-    uint32_t n_blocks[CILK_JOBS] = {0};  // The number of blocks written to the file
+    // STEP 4 - Write the number of blocks of each section
     fwrite(&n_blocks, sizeof(n_blocks[0]), CILK_JOBS, compressed);  // Write the number of blocks.
     meta_data_size += sizeof(n_blocks[0]) * CILK_JOBS;  // Update the meta data size
+#endif
+
+#ifdef STORED_SECTIONS
+    // STEP 4b - Write if each section is stored
+    fwrite(&stored, sizeof(stored[0]), CILK_JOBS, compressed);
+    meta_data_size += sizeof(stored[0]) * CILK_JOBS;  // Update the meta data size
+#endif
 
     // STEP 5 - Write the block size used to group data to the compressed file.
     fwrite(&block_size, sizeof(block_size), 1, compressed);
     meta_data_size += sizeof(block_size);  // Update the meta data size
 
-    // STEP 6 - Write the huffman table to the beginning of the file
-    writeHuffmanToFile(compressed, huffman, &meta_data_size);
+    // The file has no tables if every section is stored
+    bool has_tables = false;
+
+    for (uint8_t section_stored : stored) {
+        has_tables = has_tables || section_stored == 0;
+    }
+
+    if (has_tables) {
+        // STEP 6 - Write the huffman table to the beginning of the file
+        meta_data_size += writeHuffmanTable(compressed, huffman);
+
+#ifdef SECTION_TABLES
+        // STEP 7 - Write the tables of the sections
+        meta_data_size += writeSectionTables(compressed, huffman, section_tables, n_sections);
+#endif
+    }
+
+    // The header is complete. The jobs write the sections to the descriptor of the file
+    fflush(compressed);
+    int fd = fileno(compressed);
 
     uint16_t buffer_size = block_size / SYM_BUFF_SIZE;
 
     // Create the arguments of every thread
     for (int i = 0; i < CILK_JOBS; i++) {
-
+#ifdef CONTIGUOUS_STREAM
+        // The thread starts writing from the element of its first bit
+        args[i].section = &sections[i];
+        args[i].start_byte = i == 0 ? 0 : args[i - 1].end_byte;
+        args[i].end_byte += args[i].start_byte;
+        args[i].compressed_start_byte = meta_data_size + sections[i].start_bit / SYM_BUFF_SIZE * (SYM_BUFF_SIZE / 8);
+
+        uint64_t end_element = (sections[i].start_bit + sections[i].n_bits + SYM_BUFF_SIZE - 1) / SYM_BUFF_SIZE;
+        args[i].compressed_end_byte = meta_data_size + end_element * (SYM_BUFF_SIZE / 8);
+#else
         // if the number of bits don't align to the block size
         if (args[i].compressed_end_byte % block_size != 0) {
             // This is the number of blocks required
@@ -340,12 +478,21 @@ void compressFile(const string& filename, const string& compressed_filename, ASC
             // The end byte of the thread is the calculated end byte + the start byte
             args[i].compressed_end_byte += args[i].compressed_start_byte;
         }
+#endif
 
         args[i].number_of_blocks = &n_blocks[i];  // The number of blocks that the thread writes to the file
         args[i].number_of_padding = &section_padding[i];  // The number of padding bits that the thread writes to the end of it's section
         args[i].buffer_size = buffer_size;  // The size of the buffer
+        args[i].fd = fd;  // The descriptor of the compressed file
     }
 
+    // The size of the compressed file is known before any section is written, so its blocks are reserved at once
+#ifdef CONTIGUOUS_STREAM
+    reserveFile(fd, meta_data_size + streamBlocks(stream_bits, block_size) * (block_size / 8));
+#else
+    reserveFile(fd, args[CILK_JOBS - 1].compressed_end_byte);
+#endif
+
     #ifdef DEBUG_MODE
         cout << "\n\nmetadata size: " << meta_data_size << endl;
         for (int i = 0; i< CILK_JOBS; i++) {
@@ -375,15 +522,92 @@ void compressFile(const string& filename, const string& compressed_filename, ASC
         }
     }
 
-    // update the number of padding bits and the number of blocks written tho the compressed file
-    fseek(compressed, CILK_JOBS * 8 + 1, SEEK_SET);  // Seek to the beginning of the padding bits
+#ifdef CONTIGUOUS_STREAM
+    // Merge the elements shared by two sections and pad the stream to a whole block
+    writeStreamTails(compressed, meta_data_size, sections, CILK_JOBS, block_size);
+#endif
 
-    // Write the number of padding bits of every section to the meta data.
-    fwrite(&section_padding, sizeof(section_padding[0]), CILK_JOBS, compressed);
+    // Close the file free memory and destroy the attributes
+    fclose(compressed);
 
-    // Write the number of blocks of every section to the meta data.
-    fwrite(&n_blocks, sizeof(n_blocks[0]), CILK_JOBS, compressed);
+    for (ASCIIHuffman *section_table : section_tables) {
+        if (section_table != huffman) {
+            free(section_table);
+        }
+    }
+
+#ifdef SPARSE_FILES
+    // The extent map is stored after the compressed data
+    appendSparseMap(compressed_filename, &map);
+    freeSparseMap(&map);
+#endif
+}
+
+
+#ifdef FUSED_MODE
+
+/**
+ * Compresses the file in a single pass (fused mode). The file is processed in batches of CILK_JOBS chunks. Every
+ * iteration of the first cilk_for reads one chunk with pread and counts it, the chunks get their tables in order, then
+ * every iteration of the second cilk_for encodes one chunk while it is still in the cache and the encoded chunks are
+ * written in order. The compressed file has the format described in fused.h.
+ *
+ * @param filename             The name of the input file
+ * @param compressed_filename  The name of the compressed file
+ */
+void compressFileFused(const string& filename, const string& compressed_filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        cout << "File not found..." << endl;
+        exit(-1);
+    }
+
+    FILE *compressed = openBinaryFile(compressed_filename, "wb");
+
+    uint64_t file_len = fileSize(filename);
+    uint64_t n_chunks = (file_len + FUSED_CHUNK_SIZE - 1) / FUSED_CHUNK_SIZE;
+
+    writeFusedHeader(compressed, file_len);
+
+    FusedChunk chunks[CILK_JOBS];
+    FusedTable table;
+
+    for (FusedChunk &chunk : chunks) {
+        initFusedChunk(&chunk);
+    }
+
+    for (uint64_t first = 0; first < n_chunks; first += CILK_JOBS) {
+        int batch = n_chunks - first < CILK_JOBS ? (int) (n_chunks - first) : CILK_JOBS;
+
+        cilk_for (int i = 0; i < batch; ++i) {
+            ssize_t n_read = pread(fd, chunks[i].data, FUSED_CHUNK_SIZE, (off_t) ((first + i) * FUSED_CHUNK_SIZE));
+            chunks[i].n_chars = n_read > 0 ? (uint32_t) n_read : 0;
+
+            countFusedChunk(&chunks[i]);
+        }
+
+        // The table of a chunk depends on the tables of the chunks before it
+        for (int i = 0; i < batch; ++i) {
+            chooseFusedTable(&chunks[i], &table);
+        }
+
+        cilk_for (int i = 0; i < batch; ++i) {
+            encodeFusedChunk(&chunks[i]);
+        }
+
+        // The chunks are written in the order of the file
+        for (int i = 0; i < batch; ++i) {
+            writeFusedChunk(compressed, &chunks[i]);
+        }
+    }
+
+    for (FusedChunk &chunk : chunks) {
+        freeFusedChunk(&chunk);
+    }
 
-    // Close the file free memory and destroy the attributes
     fclose(compressed);
-}
\ No newline at end of file
+    close(fd);
+}
+
+#endif
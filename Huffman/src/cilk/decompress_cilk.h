@@ -6,29 +6,29 @@
  *
  *   Step 1: Read the meta data from of the file.
  *
- *      Byte 0         The number of sections in the file (uint8_t)  (In this example 3)
- *      Byte 1:8       The number of decompressed characters of the first section (uint64_t)
- *      Byte 9:16      The number of decompressed characters of the second section (uint64_t)
- *      Byte 17:24     The number of decompressed characters of the third section (uint64_t)
- *      .
- *      .
- *      .
- *      Byte 45:28     The number of the padding bits added to the end of the first section (uint32_t)
- *      Byte 29:32     The number of the padding bits added to the end of the second section (uint32_t)
- *      Byte 33:36     The number of the padding bits added to the end of the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 37:40     The number of blocks in the first section (uint32_t)
- *      Byte 41:44     The number of blocks in the second section (uint32_t)
- *      Byte 45:48     The number of blocks in the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 49:50     The block size used to group data (uint16_t)
- *      Byte 51:8507   The huffman table used to compress the file. After every 256 bit symbol the number of bits used
- *                     by the symbol are written as well as an 8 bit number. The size of the table is 256 x (256 + 8) bits
- *      Byte 8508:end  The compressed data
+ *      The fields follow each other in this order, n is the number of sections. The tables have a variable size, so the
+ *      offset of the data depends on their kinds:
+ *
+ *      uint8_t        The number of sections n
+ *      uint64_t[n]    The number of characters of every section
+ *      uint32_t[n]    The number of the padding bits added to the end of every section
+ *      uint32_t[n]    The number of blocks of every section
+ *                     (CONTIGUOUS_STREAM) Instead of the padding bits and the blocks, the number of bits of every
+ *                     section (uint64_t[n]). The sections are back to back in one stream padded to a whole block (see
+ *                     stream.h)
+ *      uint8_t[n]     (STORED_SECTIONS) Whether every section is stored
+ *      uint16_t       The block size used to group data
+ *      table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by the
+ *                     symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES), the id of a
+ *                     shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h. There are no
+ *                     tables if every section is stored
+ *      tables         (SECTION_TABLES) For every section a flag (uint8_t) followed by the table of the section if the
+ *                     flag is 1
+ *      data           The compressed data of the sections one after the other
+ *                     (INTERLEAVED_LANES) The data of every section is a sequence of lane frames (see lanes.h)
+ *                     (STORED_SECTIONS) The data of a stored section is its characters padded with 0 bytes to a whole
+ *                     block
+ *      extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  *   Step 2: Create the Huffman tree from the huffman table
  *
@@ -39,5 +39,18 @@
  */
 void decompressFile(const std::string& filename, const std::string& decompressed_filename);
 
+
+#ifdef FUSED_MODE
+
+/**
+ * Decompresses a file compressed with compressFileFused (see fused.h for the format)
+ *
+ * @param filename               The name of the file to be decompressed
+ * @param decompressed_filename  The name of the decompressed file
+ */
+void decompressFileFused(const std::string& filename, const std::string& decompressed_filename);
+
+#endif
+
 #endif
 
@@ -4,6 +4,10 @@
 #include "../structs.h"
 #include "../huffman.h"
 #include "../file_utils.h"
+#include "../freq_cache.h"
+#include "../histogram.h"
+#include "../presets.h"
+#include "../bit_writer.h"
 #include "char_frequency_cilk.h"
 #include "compress_cilk.h"
 #include "decompress_cilk.h"
@@ -42,17 +46,51 @@ int main(int argc, char **argv) {
     startTimer(&overall_timer);
     startTimer(&all);
 
+#ifdef FUSED_MODE
+    // The frequencies, the table and the compressed data of every chunk are created in a single pass
+    cout << "Compressing file in fused mode (" << FUSED_CHUNK_SIZE << " byte chunks)..." << endl;
+
+    startTimer(&timer);
+
+    compressFileFused(input_file_name, output_file_name);
+
+    stopTimer(&timer);
+
+    cout << "Compression elapsed time: ";
+    displayElapsed(&timer);
+    displayThroughput(&timer, fileSize(input_file_name));
+#else
     cout << "Calculating frequencies..." << endl;
 
     startTimer(&timer);
 
+#ifdef FREQUENCY_CACHE
+    // Skip the frequency pass if the frequencies of the file are cached
+    if (loadFrequencyCache(input_file_name, &huffman, CILK_JOBS, true)) {
+        cout << "Frequencies loaded from " << input_file_name << FREQ_CACHE_EXTENSION << endl;
+
+    } else {
+        calculateFrequency(input_file_name, &huffman);
+
+        storeFrequencyCache(input_file_name, &huffman, CILK_JOBS, true);
+    }
+#else
     calculateFrequency(input_file_name, &huffman);
+#endif
 
     stopTimer(&timer);
 
     cout << "Frequency elapsed time: ";
     displayElapsed(&timer);
 
+    // The size of the input file is the sum of all the frequencies
+    uint64_t input_size = 0;
+    for (uint64_t freq : huffman.charFreq) {
+        input_size += freq;
+    }
+
+    displayThroughput(&timer, input_size);
+
     #ifdef DEBUG_MODE
         cout << "Characters frequency: " << endl;
 
@@ -64,11 +102,20 @@ int main(int argc, char **argv) {
         cout <<  huffman.charFreq[255] << endl;
     #endif
 
+#ifdef TABLE_PRESET
+    // The frequencies only place the sections in the file, the symbols of the preset are used
+    cout << "Loading the table preset " << TABLE_PRESET << "..." << endl;
+
+    startTimer(&timer);
+
+    loadPreset(TABLE_PRESET, &huffman);
+#else
     cout << "Calculating symbols..." << endl;
 
     startTimer(&timer);
 
     createHuffmanTree(&huffman);
+#endif
 
     stopTimer(&timer);
 
@@ -84,16 +131,24 @@ int main(int argc, char **argv) {
         }
     #endif
 
-    cout << "Compressing file..." << endl;
+    cout << "Compressing file (" << encodeKernelName() << " kernel)..." << endl;
 
     startTimer(&timer);
 
     compressFile(input_file_name, output_file_name, &huffman, 8192 * 4);
 
+    // A stored preset is referenced as a shared table
+    if (huffman.table_id != 0) {
+        storeSharedTable(output_file_name, &huffman);
+    }
+
     stopTimer(&timer);
 
     cout << "Compression elapsed time: ";
     displayElapsed(&timer);
+    displayThroughput(&timer, fileSize(input_file_name));
+
+#endif
 
     stopTimer(&overall_timer);
 
@@ -104,7 +159,11 @@ int main(int argc, char **argv) {
 
     startTimer(&timer);
 
+#ifdef FUSED_MODE
+    decompressFileFused(output_file_name, decompressed_file_name);
+#else
     decompressFile(output_file_name, decompressed_file_name);
+#endif
 
     stopTimer(&timer);
 
@@ -0,0 +1,144 @@
+#ifndef CODE_BUILDER_H
+#define CODE_BUILDER_H
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+
+/*
+ * Huffman code construction for alphabets of any size (bytes, byte pairs, words, length/literal symbols). The symbols
+ * are sorted by frequency once (O(n log n)) and the tree is built with two queues in O(n): the sorted leaves and the
+ * internal nodes, which are created in increasing weight order. The code lengths are assigned iteratively from the
+ * parent links and the codes are canonical, so no tree is kept and no recursion is needed.
+ */
+
+
+/**
+ * Calculates the huffman code lengths of an alphabet. Every symbol gets a code, including the symbols with a frequency
+ * of 0 (they get the longest ones). A single symbol alphabet gets a 1 bit code.
+ *
+ * @tparam Freq       The frequency type
+ * @param frequencies The frequency of every symbol
+ * @param n_symbols   The number of symbols of the alphabet
+ * @param lengths     The code length of every symbol (n_symbols elements)
+ */
+template <typename Freq>
+void huffmanCodeLengths(const Freq *frequencies, uint32_t n_symbols, uint8_t *lengths) {
+    if (n_symbols == 0) {
+        return;
+    }
+
+    if (n_symbols == 1) {
+        lengths[0] = 1;
+        return;
+    }
+
+    // The symbols sorted by frequency. The symbols with the same frequency are sorted by symbol
+    struct Leaf {
+        Freq freq;
+        uint32_t symbol;
+    };
+
+    auto *leaves = (Leaf *) malloc(n_symbols * sizeof(Leaf));
+
+    for (uint32_t i = 0; i < n_symbols; ++i) {
+        leaves[i].freq = frequencies[i];
+        leaves[i].symbol = i;
+    }
+
+    std::sort(leaves, leaves + n_symbols, [](const Leaf &a, const Leaf &b) {
+        return a.freq < b.freq || (a.freq == b.freq && a.symbol < b.symbol);
+    });
+
+    /*
+     * The internal nodes are created in increasing weight order, so they form the second queue. The parent of every
+     * leaf (in sorted order) and of every internal node is kept to find the depths.
+     */
+    uint32_t n_internal = n_symbols - 1;
+
+    auto *weights = (Freq *) malloc(n_internal * sizeof(Freq));
+    auto *leaf_parent = (uint32_t *) malloc(n_symbols * sizeof(uint32_t));
+    auto *internal_parent = (uint32_t *) malloc(n_internal * sizeof(uint32_t));
+
+    uint32_t next_leaf = 0;      // The first leaf not in the tree
+    uint32_t next_internal = 0;  // The first internal node not in the tree
+
+    for (uint32_t node = 0; node < n_internal; ++node) {
+        Freq weight = 0;
+
+        // Take the two smallest nodes of the queues. On a tie the leaf is taken, which keeps the codes short
+        for (int child = 0; child < 2; ++child) {
+            if (next_leaf < n_symbols && (next_internal == node || leaves[next_leaf].freq <= weights[next_internal])) {
+                weight += leaves[next_leaf].freq;
+                leaf_parent[next_leaf++] = node;
+
+            } else {
+                weight += weights[next_internal];
+                internal_parent[next_internal++] = node;
+            }
+        }
+
+        weights[node] = weight;
+    }
+
+    // The root is the last internal node. The depth of a node is the depth of its parent (created later) plus one
+    auto *depths = (uint8_t *) malloc(n_internal * sizeof(uint8_t));
+
+    depths[n_internal - 1] = 0;
+
+    for (int64_t node = (int64_t) n_internal - 2; node >= 0; --node) {
+        depths[node] = depths[internal_parent[node]] + 1;
+    }
+
+    for (uint32_t i = 0; i < n_symbols; ++i) {
+        lengths[leaves[i].symbol] = depths[leaf_parent[i]] + 1;
+    }
+
+    free(depths);
+    free(internal_parent);
+    free(leaf_parent);
+    free(weights);
+    free(leaves);
+}
+
+
+/**
+ * Assigns canonical codes to the code lengths of an alphabet. The codes of the same length are consecutive numbers
+ * ordered by symbol and every code is bigger than the codes of the shorter lengths. The first bit of a code is the MSB
+ * of its length bit number. The code word must fit the longest code.
+ *
+ * @tparam CodeWord  The code word type
+ * @param lengths    The code length of every symbol (0 for a symbol without a code)
+ * @param n_symbols  The number of symbols of the alphabet
+ * @param codes      The code of every symbol (n_symbols elements)
+ */
+template <typename CodeWord>
+void canonicalCodes(const uint8_t *lengths, uint32_t n_symbols, CodeWord *codes) {
+    uint32_t length_count[256] = {0};
+
+    for (uint32_t i = 0; i < n_symbols; ++i) {
+        length_count[lengths[i]]++;
+    }
+
+    // The first code of every length
+    CodeWord next_code[256];
+    CodeWord code = 0;
+
+    length_count[0] = 0;
+
+    for (int length = 1; length < 256; ++length) {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+
+    for (uint32_t i = 0; i < n_symbols; ++i) {
+        codes[i] = 0;
+
+        if (lengths[i] != 0) {
+            codes[i] = next_code[lengths[i]];
+            next_code[lengths[i]] += 1;
+        }
+    }
+}
+
+#endif
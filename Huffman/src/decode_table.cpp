@@ -0,0 +1,223 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "decode_table.h"
+#include "huffman.h"
+
+//#define DEBUG_MODE
+
+#ifdef TABLE_DECODING
+
+#define NO_CHILD 0xffff  // The index of a missing child of a node
+
+
+/**
+ * Returns the depth of the deepest leaf under a node
+ *
+ * @param nodes  The huffman tree array
+ * @param node   The index of the node
+ * @return       The height of the node (0 for a leaf)
+ */
+static uint32_t nodeHeight(const HuffmanNode *nodes, uint16_t node) {
+    if (nodes[node].isLeaf) {
+        return 0;
+    }
+
+    uint32_t left = nodes[node].left != NO_CHILD ? nodeHeight(nodes, nodes[node].left) : 0;
+    uint32_t right = nodes[node].right != NO_CHILD ? nodeHeight(nodes, nodes[node].right) : 0;
+
+    return (left > right ? left : right) + 1;
+}
+
+
+/**
+ * Appends the table of a node to the decode table. Every index of the table is walked from the node and the internal
+ * nodes at the depth of the bits of the table get their own table.
+ *
+ * @param table  The decode table
+ * @param nodes  The huffman tree array
+ * @param node   The index of the node of the table
+ * @param bits   The number of bits of the table
+ * @return       The offset of the table in the entries
+ */
+static uint32_t appendDecodeTable(DecodeTable *table, const HuffmanNode *nodes, uint16_t node, uint32_t bits) {
+    uint32_t offset = table->n_entries;
+
+    table->n_entries += 1U << bits;
+    table->entries = (uint32_t *) realloc(table->entries, table->n_entries * sizeof(uint32_t));
+
+    for (uint32_t index = 0; index < 1U << bits; ++index) {
+        uint16_t current = node;
+        uint32_t length = 0;
+
+        // Walk the bits of the index until a leaf (the rest of the bits belong to the next symbols)
+        while (length < bits && current != NO_CHILD && !nodes[current].isLeaf) {
+            bool bit = (index >> (bits - 1 - length)) & 1;
+
+            current = bit ? nodes[current].right : nodes[current].left;
+            ++length;
+        }
+
+        if (current == NO_CHILD) {
+            // The bits are not a symbol of the table (they are never in a valid stream)
+            table->entries[offset + index] = length;
+
+        } else if (nodes[current].isLeaf) {
+            table->entries[offset + index] = (uint32_t) nodes[current].ascii_index << 8 | length;
+
+        } else {
+            // The symbols of the node are longer than the bits of the table
+            uint32_t height = nodeHeight(nodes, current);
+            uint32_t sub_bits = height < DECODE_TABLE_BITS ? height : DECODE_TABLE_BITS;
+            uint32_t sub_offset = appendDecodeTable(table, nodes, current, sub_bits);
+
+            table->entries[offset + index] = DECODE_TABLE_LINK | sub_offset << 8 | sub_bits;
+        }
+    }
+
+    return offset;
+}
+
+
+#ifdef MULTI_SYMBOL_DECODING
+
+/**
+ * Builds the multi symbol table from the first level table. The symbols of every index are decoded one after the other
+ * with the first level table while they fit the bits of the index.
+ *
+ * @param table  The decode table (with its first level table)
+ */
+static void buildMultiTable(DecodeTable *table) {
+    const uint32_t n_entries = 1U << MULTI_DECODE_BITS;
+    const uint64_t index_mask = n_entries - 1;
+    const uint32_t root_bits = table->root_bits;
+
+    table->multi = (uint64_t *) malloc(n_entries * sizeof(uint64_t));
+
+    for (uint32_t index = 0; index < n_entries; ++index) {
+        uint64_t characters = 0;
+        uint32_t length = 0;
+        uint32_t n = 0;
+
+        while (n < MULTI_DECODE_SYMBOLS && length < MULTI_DECODE_BITS) {
+            // The bits of the index after the decoded symbols (followed by 0 bits) as an index of the first level table
+            uint64_t rest = ((uint64_t) index << length) & index_mask;
+            uint64_t root_index = MULTI_DECODE_BITS >= root_bits ? rest >> (MULTI_DECODE_BITS - root_bits)
+                                                                : rest << (root_bits - MULTI_DECODE_BITS);
+
+            uint32_t entry = table->entries[root_index];
+
+            // The symbol must be a whole symbol of the index
+            if ((entry & DECODE_TABLE_LINK) || length + (entry & 0xff) > MULTI_DECODE_BITS) {
+                break;
+            }
+
+            characters |= (uint64_t) (entry >> 8 & 0xff) << (8 * n);
+            length += entry & 0xff;
+            ++n;
+        }
+
+        table->multi[index] = (uint64_t) n << 40 | (uint64_t) length << 32 | characters;
+    }
+}
+
+#endif
+
+
+/**
+ * Builds the decode table of a huffman table
+ *
+ * @param table    The decode table
+ * @param huffman  The huffman struct with the symbols
+ */
+void buildDecodeTable(DecodeTable *table, ASCIIHuffman *huffman) {
+    // The tree with the full code words, the table is built once per table of the file
+    auto *nodes = (HuffmanNode *) malloc(511 * sizeof(HuffmanNode));
+    uint16_t root_index = huffmanFromArray(huffman, nodes);
+
+    uint32_t height = nodeHeight(nodes, root_index);
+
+    table->entries = nullptr;
+    table->n_entries = 0;
+    table->root_bits = height < DECODE_TABLE_BITS ? height : DECODE_TABLE_BITS;
+
+    appendDecodeTable(table, nodes, root_index, table->root_bits);
+
+#ifdef MULTI_SYMBOL_DECODING
+    buildMultiTable(table);
+#endif
+
+#ifdef DEBUG_MODE
+    std::cout << "Decode table: " << table->n_entries << " entries, " << table->root_bits << " root bits" << std::endl;
+#endif
+
+    free(nodes);
+}
+
+
+/**
+ * Frees the entries of a decode table
+ *
+ * @param table  The decode table
+ */
+void freeDecodeTable(DecodeTable *table) {
+    free(table->entries);
+    table->entries = nullptr;
+    table->n_entries = 0;
+
+#ifdef MULTI_SYMBOL_DECODING
+    free(table->multi);
+    table->multi = nullptr;
+#endif
+}
+
+
+/**
+ * Decodes a stream with the decode table and writes the characters to the decompressed file
+ *
+ * @param table         The decode table
+ * @param reader        The reader of the stream (at the first symbol)
+ * @param n_bits        The number of bits of the stream
+ * @param decompressed  The decompressed file
+ */
+void decodeTableStream(const DecodeTable *table, BitReader *reader, uint64_t n_bits, FILE *decompressed) {
+    // The multi symbol entries store all their characters, so the buffer has room for a whole entry at its end
+    auto *char_buffer = (uint8_t *) malloc(DECODE_BUFFER_SIZE + MULTI_DECODE_SYMBOLS);
+    uint32_t c_index = 0;
+
+    while (n_bits > 0) {
+#ifdef MULTI_SYMBOL_DECODING
+        uint64_t entry = table->multi[peekBits(reader, MULTI_DECODE_BITS)];
+        auto multi_length = (uint32_t) (entry >> 32 & 0xff);
+
+        // The symbols of the entry are decoded at once unless they are not in the stream (after its end)
+        if (multi_length != 0 && multi_length <= n_bits) {
+            auto characters = (uint32_t) entry;
+            memcpy(char_buffer + c_index, &characters, sizeof(characters));
+
+            c_index += (uint32_t) (entry >> 40);
+            getBits(reader, multi_length);
+            n_bits -= multi_length;
+
+        } else
+#endif
+        {
+            uint32_t length;
+            char_buffer[c_index++] = decodeTableSymbol(table, reader, &length);
+
+            // A symbol never crosses the end of a valid stream
+            n_bits -= length < n_bits ? length : n_bits;
+        }
+
+        if (c_index >= DECODE_BUFFER_SIZE) {
+            fwrite(char_buffer, sizeof(char_buffer[0]), c_index, decompressed);
+            c_index = 0;
+        }
+    }
+
+    fwrite(char_buffer, sizeof(char_buffer[0]), c_index, decompressed);
+    free(char_buffer);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef DECODE_TABLE_H
+#define DECODE_TABLE_H
+
+#include <cstdio>
+
+#include "structs.h"
+#include "bit_reader.h"
+
+#ifdef TABLE_DECODING
+
+/*
+ * Table decoding (TABLE_DECODING). The decoder peeks the next bits of the stream and looks them up in a table instead
+ * of walking the huffman tree one bit at a time. The first level table is indexed with the next DECODE_TABLE_BITS bits
+ * (fewer if the tree is not as deep). An entry is either a leaf or a link:
+ *
+ *      leaf    (character << 8) | length               The symbol of the character is the first length bits
+ *      link    DECODE_TABLE_LINK | (offset << 8) | n   The symbol is longer than the bits of the table. The table bits
+ *                                                      are consumed and the next n bits are looked up in the table that
+ *                                                      starts at entry offset
+ *
+ * The tables are built from the tree (buildDecodeTable). Every internal node at the depth of the bits of its table gets
+ * a second level table of up to DECODE_TABLE_BITS bits, so a typical table (symbols up to 11 bits) is a single lookup
+ * and the longest symbols (up to 255 bits) are a few.
+ *
+ * The multi symbol table (MULTI_SYMBOL_DECODING) is indexed with the next MULTI_DECODE_BITS bits. Its entries are built
+ * from the first level table and hold every whole symbol of the index, up to MULTI_DECODE_SYMBOLS of them:
+ *
+ *      (n << 40) | (length << 32) | characters     The n characters (character k in bits 8k to 8k + 7) and the total
+ *                                                  length of their symbols
+ *
+ * An entry with no characters (its first symbol is longer than the bits) and the symbols at the end of the stream are
+ * decoded with the single symbol tables.
+ */
+
+#define DECODE_TABLE_LINK (1U << 31)     // The flag of the link entries
+#define DECODE_BUFFER_SIZE (64 * 1024)   // The number of characters written to the decompressed file at a time
+#define MULTI_DECODE_SYMBOLS 4           // The maximum number of characters of a multi symbol entry
+
+
+typedef struct decode_table {
+    uint32_t *entries = nullptr;  /// The entries of the first level table followed by the second level tables
+    uint32_t n_entries = 0;       /// The number of entries
+    uint32_t root_bits = 0;       /// The number of bits of the first level table
+
+#ifdef MULTI_SYMBOL_DECODING
+    uint64_t *multi = nullptr;    /// The multi symbol table (2^MULTI_DECODE_BITS entries)
+#endif
+} DecodeTable;
+
+
+/**
+ * Builds the decode table of a huffman table
+ *
+ * @param table    The decode table
+ * @param huffman  The huffman struct with the symbols
+ */
+void buildDecodeTable(DecodeTable *table, ASCIIHuffman *huffman);
+
+
+/**
+ * Frees the entries of a decode table
+ *
+ * @param table  The decode table
+ */
+void freeDecodeTable(DecodeTable *table);
+
+
+/**
+ * Decodes a stream with the decode table and writes the characters to the decompressed file
+ *
+ * @param table         The decode table
+ * @param reader        The reader of the stream (at the first symbol)
+ * @param n_bits        The number of bits of the stream
+ * @param decompressed  The decompressed file
+ */
+void decodeTableStream(const DecodeTable *table, BitReader *reader, uint64_t n_bits, FILE *decompressed);
+
+
+/**
+ * Decodes the next symbol of a stream with the decode table
+ *
+ * @param table   The decode table
+ * @param reader  The reader of the stream (advanced past the symbol)
+ * @param length  The length of the symbol in bits
+ * @return        The character
+ */
+inline uint8_t decodeTableSymbol(const DecodeTable *table, BitReader *reader, uint32_t *length) {
+    uint32_t bits = table->root_bits;
+    uint32_t entry = table->entries[peekBits(reader, bits)];
+
+    *length = 0;
+
+    // A long symbol continues in the second level tables
+    while (entry & DECODE_TABLE_LINK) {
+        getBits(reader, bits);
+        *length += bits;
+
+        bits = entry & 0xff;
+        entry = table->entries[((entry & ~DECODE_TABLE_LINK) >> 8) + peekBits(reader, bits)];
+    }
+
+    getBits(reader, entry & 0xff);
+    *length += entry & 0xff;
+
+    return entry >> 8;
+}
+
+
+/**
+ * Returns the next bits of a buffer of words without consuming them
+ *
+ * @param words     The words (word w holds bits 64w to 64w + 63 from the MSB, the word after the last bit must exist)
+ * @param position  The bit position
+ * @param length    The number of bits (1 to 64)
+ * @return          The bits (right aligned)
+ */
+inline uint64_t peekWords(const uint64_t *words, uint64_t position, uint32_t length) {
+    uint64_t word = position / 64;
+    uint32_t shift = position % 64;
+
+    // The double shift of the next word gives 0 when the bits are in a single word
+    uint64_t bits = words[word] << shift | (words[word + 1] >> 1) >> (63 - shift);
+
+    return bits >> (64 - length);
+}
+
+
+/**
+ * Decodes the symbol at a bit position of a buffer of words with the decode table
+ *
+ * @param table     The decode table
+ * @param words     The words (see peekWords)
+ * @param position  The bit position (advanced past the symbol)
+ * @return          The character
+ */
+inline uint8_t decodeTableWords(const DecodeTable *table, const uint64_t *words, uint64_t *position) {
+    uint32_t bits = table->root_bits;
+    uint32_t entry = table->entries[peekWords(words, *position, bits)];
+
+    while (entry & DECODE_TABLE_LINK) {
+        *position += bits;
+
+        bits = entry & 0xff;
+        entry = table->entries[((entry & ~DECODE_TABLE_LINK) >> 8) + peekWords(words, *position, bits)];
+    }
+
+    *position += entry & 0xff;
+
+    return entry >> 8;
+}
+
+#endif
+
+#endif
@@ -1,4 +1,7 @@
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "file_utils.h"
 
@@ -55,6 +58,122 @@ FILE *openBinaryFile(const string& filename, const char *mode) {
 }
 
 
+/**
+ * Returns the size of a file in bytes
+ *
+ * @param filename The file name
+ * @return  The size of the file
+ */
+uint64_t fileSize(const string& filename) {
+    struct stat file_stat{};
+
+    if (stat(filename.c_str(), &file_stat) != 0) {
+        cout << "File not found..." << endl;
+        exit(-1);
+    }
+
+    return (uint64_t) file_stat.st_size;
+}
+
+
+/**
+ * Reserves the blocks of a file of a known size (fallocate). The size of the file is set to the reserved size. If the
+ * file system can not reserve blocks the file grows with the writes instead.
+ *
+ * @param fd    The file descriptor
+ * @param size  The size of the file in bytes
+ */
+void reserveFile(int fd, uint64_t size) {
+    if (size == 0) {
+        return;
+    }
+
+#ifdef __linux__
+    // A file system without fallocate (EOPNOTSUPP) leaves the file as it is
+    fallocate(fd, 0, 0, (off_t) size);
+#endif
+}
+
+
+/**
+ * Writes a buffer to an offset of a file with pwrite. The offset of the descriptor is not used, so the descriptor can
+ * be shared by threads that write different parts of the file.
+ *
+ * @param fd      The file descriptor
+ * @param buffer  The bytes to write
+ * @param length  The number of bytes
+ * @param offset  The offset of the first byte in the file
+ */
+void writeFileAt(int fd, const void *buffer, uint64_t length, uint64_t offset) {
+    auto *bytes = (const uint8_t *) buffer;
+
+    while (length > 0) {
+        ssize_t n_written = pwrite(fd, bytes, length, (off_t) offset);
+
+        if (n_written <= 0) {
+            cout << "Could not write to the compressed file" << endl;
+            exit(-1);
+        }
+
+        bytes += n_written;
+        length -= n_written;
+        offset += n_written;
+    }
+}
+
+
+/**
+ * Copies bytes from an offset of a file to an offset of another file. The kernel copies them (copy_file_range) without
+ * passing them through a buffer of the process if it can, otherwise they are copied with pread and pwrite. The offsets
+ * of the descriptors are not used.
+ *
+ * @param in_fd       The descriptor of the file to copy from
+ * @param in_offset   The offset of the first byte in the file to copy from
+ * @param out_fd      The descriptor of the file to copy to
+ * @param out_offset  The offset of the first byte in the file to copy to
+ * @param length      The number of bytes
+ */
+void copyFileRange(int in_fd, uint64_t in_offset, int out_fd, uint64_t out_offset, uint64_t length) {
+#ifdef __linux__
+    while (length > 0) {
+        auto in_off = (loff_t) in_offset;
+        auto out_off = (loff_t) out_offset;
+
+        // Old kernels and some file systems can not copy (EXDEV, ENOSYS, ...), the rest is copied with a buffer
+        ssize_t n_copied = copy_file_range(in_fd, &in_off, out_fd, &out_off, length, 0);
+
+        if (n_copied <= 0) {
+            break;
+        }
+
+        in_offset += n_copied;
+        out_offset += n_copied;
+        length -= n_copied;
+    }
+#endif
+
+    const uint64_t buffer_size = 1024 * 1024;
+    auto *buffer = (uint8_t *) malloc(length < buffer_size ? length : buffer_size);
+
+    while (length > 0) {
+        ssize_t n_read = pread(in_fd, buffer, length < buffer_size ? length : buffer_size, (off_t) in_offset);
+
+        if (n_read <= 0) {
+            cout << "Could not read the file to copy" << endl;
+            exit(-1);
+        }
+
+        writeFileAt(out_fd, buffer, n_read, out_offset);
+
+        in_offset += n_read;
+        out_offset += n_read;
+        length -= n_read;
+    }
+
+    free(buffer);
+}
+
+
 /**
  * Calculates the sha256 hash of the input and output files and compares the results
  * @param input_file
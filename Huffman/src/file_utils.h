@@ -13,6 +13,51 @@
 FILE *openBinaryFile(const std::string& filename, const char *mode);
 
 
+/**
+ * Returns the size of a file in bytes
+ *
+ * @param filename The file name
+ * @return  The size of the file
+ */
+uint64_t fileSize(const std::string& filename);
+
+
+/**
+ * Reserves the blocks of a file of a known size (fallocate). The size of the file is set to the reserved size. If the
+ * file system can not reserve blocks the file grows with the writes instead.
+ *
+ * @param fd    The file descriptor
+ * @param size  The size of the file in bytes
+ */
+void reserveFile(int fd, uint64_t size);
+
+
+/**
+ * Writes a buffer to an offset of a file with pwrite. The offset of the descriptor is not used, so the descriptor can
+ * be shared by threads that write different parts of the file.
+ *
+ * @param fd      The file descriptor
+ * @param buffer  The bytes to write
+ * @param length  The number of bytes
+ * @param offset  The offset of the first byte in the file
+ */
+void writeFileAt(int fd, const void *buffer, uint64_t length, uint64_t offset);
+
+
+/**
+ * Copies bytes from an offset of a file to an offset of another file. The kernel copies them (copy_file_range) without
+ * passing them through a buffer of the process if it can, otherwise they are copied with pread and pwrite. The offsets
+ * of the descriptors are not used.
+ *
+ * @param in_fd       The descriptor of the file to copy from
+ * @param in_offset   The offset of the first byte in the file to copy from
+ * @param out_fd      The descriptor of the file to copy to
+ * @param out_offset  The offset of the first byte in the file to copy to
+ * @param length      The number of bytes
+ */
+void copyFileRange(int in_fd, uint64_t in_offset, int out_fd, uint64_t out_offset, uint64_t length);
+
+
 /**
  * Calculates the sha256 hash of the input and output files and compares the results
  * @param input_file
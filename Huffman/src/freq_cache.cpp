@@ -0,0 +1,207 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+#include "freq_cache.h"
+
+//#define DEBUG_MODE
+
+
+/**
+ * The header of the sidecar cache. The first fields identify the cached file, the frequencies follow the header:
+ *
+ *      uint64_t charFreq[256]
+ *      uint64_t frequencies[n_sections][256]
+ */
+typedef struct freq_cache_header {
+    uint32_t magic;         /// FREQ_CACHE_MAGIC
+    uint8_t version;        /// FREQ_CACHE_VERSION
+    uint8_t n_sections;     /// The number of section histograms stored after charFreq
+    uint8_t exact;          /// 1 if the frequencies were counted, 0 if they were estimated
+
+    uint64_t device;        /// The device of the file
+    uint64_t inode;         /// The inode of the file
+    uint64_t size;          /// The size of the file in bytes
+    uint64_t mtime_sec;     /// The modification time of the file (seconds)
+    uint64_t mtime_nsec;    /// The modification time of the file (nanoseconds)
+    uint64_t fingerprint;   /// FNV-1a hash of the first, middle and last FREQ_CACHE_PROBE_SIZE bytes of the file
+
+} FreqCacheHeader;
+
+
+/**
+ * Hashes a buffer with the 64 bit FNV-1a hash
+ *
+ * @param hash    The hash so far
+ * @param data    The buffer to hash
+ * @param length  The length of the buffer
+ * @return        The new hash
+ */
+uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+
+/**
+ * Creates the key of the file. The key contains the identity of the file (device, inode), its size and modification
+ * time, and a cheap fingerprint of its content that catches files that were changed without updating the mtime.
+ *
+ * @param filename  The input file name
+ * @param header    The header to fill
+ * @return          False if the file can not be read
+ */
+bool createCacheKey(const std::string& filename, FreqCacheHeader *header) {
+    struct stat file_stat{};
+
+    if (stat(filename.c_str(), &file_stat) != 0) {
+        return false;
+    }
+
+    memset(header, 0, sizeof(FreqCacheHeader));
+
+    header->magic = FREQ_CACHE_MAGIC;
+    header->version = FREQ_CACHE_VERSION;
+    header->device = file_stat.st_dev;
+    header->inode = file_stat.st_ino;
+    header->size = file_stat.st_size;
+    header->mtime_sec = file_stat.st_mtim.tv_sec;
+    header->mtime_nsec = file_stat.st_mtim.tv_nsec;
+
+    FILE *file = fopen(filename.c_str(), "rb");
+
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Hash the beginning, the middle and the end of the file
+    uint8_t probe[FREQ_CACHE_PROBE_SIZE];
+    uint64_t offsets[3] = {0, header->size / 2, header->size > FREQ_CACHE_PROBE_SIZE ? header->size - FREQ_CACHE_PROBE_SIZE : 0};
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (uint64_t offset : offsets) {
+        fseek(file, (long) offset, SEEK_SET);
+        size_t n_read = fread(probe, sizeof(probe[0]), FREQ_CACHE_PROBE_SIZE, file);
+
+        hash = fnv1a(hash, probe, n_read);
+    }
+
+    header->fingerprint = hash;
+
+    fclose(file);
+
+    return true;
+}
+
+
+/**
+ * Loads the frequencies of a file from its sidecar cache. The cache is used only if the device, inode, size and
+ * modification time of the file are the ones stored in the cache and the fingerprint of the file content matches.
+ *
+ * @param filename    The input file name
+ * @param huffman     The huffman struct. charFreq (and frequencies if n_sections is not 0) are filled on a hit
+ * @param n_sections  The number of section histograms needed (0 if only charFreq is needed)
+ * @param exact_only  If true, caches created from sampled frequencies are rejected
+ * @return            True if the frequencies were loaded
+ */
+bool loadFrequencyCache(const std::string& filename, ASCIIHuffman *huffman, uint8_t n_sections, bool exact_only) {
+    FreqCacheHeader expected;
+    FreqCacheHeader stored;
+
+    if (!createCacheKey(filename, &expected)) {
+        return false;
+    }
+
+    FILE *cache = fopen((filename + FREQ_CACHE_EXTENSION).c_str(), "rb");
+
+    // There is no cache for this file
+    if (cache == nullptr) {
+        return false;
+    }
+
+    bool valid = fread(&stored, sizeof(stored), 1, cache) == 1 &&
+                 stored.magic == expected.magic &&
+                 stored.version == expected.version &&
+                 stored.device == expected.device &&
+                 stored.inode == expected.inode &&
+                 stored.size == expected.size &&
+                 stored.mtime_sec == expected.mtime_sec &&
+                 stored.mtime_nsec == expected.mtime_nsec &&
+                 stored.fingerprint == expected.fingerprint &&
+                 (stored.exact || !exact_only) &&
+                 (n_sections == 0 || stored.n_sections == n_sections);
+
+    uint64_t char_freq[256];
+
+    valid = valid && fread(char_freq, sizeof(char_freq[0]), 256, cache) == 256;
+
+    // Read the section histograms directly to the huffman struct. They are only used if the whole cache is valid
+    for (int i = 0; valid && i < n_sections; ++i) {
+        valid = fread(huffman->frequencies[i], sizeof(huffman->frequencies[i][0]), 256, cache) == 256;
+    }
+
+    fclose(cache);
+
+#ifdef DEBUG_MODE
+    std::cout << "Frequency cache " << (valid ? "hit" : "miss") << std::endl;
+#endif
+
+    if (!valid) {
+        return false;
+    }
+
+    for (int i = 0; i < 256; ++i) {
+        huffman->charFreq[i] = char_freq[i];
+    }
+
+    return true;
+}
+
+
+/**
+ * Stores the frequencies of a file to its sidecar cache (filename + FREQ_CACHE_EXTENSION). The cache is written to a
+ * temporary file first and then renamed, so a cache is never seen half written.
+ *
+ * @param filename    The input file name
+ * @param huffman     The huffman struct with the frequencies
+ * @param n_sections  The number of section histograms to store (0 if only charFreq is known)
+ * @param exact       False if the frequencies are estimated (sampling mode)
+ */
+void storeFrequencyCache(const std::string& filename, ASCIIHuffman *huffman, uint8_t n_sections, bool exact) {
+    FreqCacheHeader header;
+
+    if (!createCacheKey(filename, &header)) {
+        return;
+    }
+
+    header.n_sections = n_sections;
+    header.exact = exact ? 1 : 0;
+
+    std::string cache_name = filename + FREQ_CACHE_EXTENSION;
+    std::string tmp_name = cache_name + ".tmp";
+
+    FILE *cache = fopen(tmp_name.c_str(), "wb");
+
+    // The directory may not be writable. The cache is optional so nothing else is done
+    if (cache == nullptr) {
+        std::cout << "Could not create the frequency cache " << cache_name << std::endl;
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, cache);
+    fwrite(huffman->charFreq, sizeof(huffman->charFreq[0]), 256, cache);
+
+    for (int i = 0; i < n_sections; ++i) {
+        fwrite(huffman->frequencies[i], sizeof(huffman->frequencies[i][0]), 256, cache);
+    }
+
+    fclose(cache);
+
+    rename(tmp_name.c_str(), cache_name.c_str());
+}
@@ -0,0 +1,48 @@
+#ifndef FREQ_CACHE_H
+#define FREQ_CACHE_H
+
+#include <string>
+
+#include "structs.h"
+
+#define FREQ_CACHE_MAGIC 0x51524648      // "HFRQ"
+#define FREQ_CACHE_VERSION 1
+#define FREQ_CACHE_EXTENSION ".freq"
+#define FREQ_CACHE_PROBE_SIZE 4096       // The size of every chunk hashed for the fingerprint
+
+
+/**
+ * Hashes a buffer with the 64 bit FNV-1a hash
+ *
+ * @param hash    The hash so far (0xcbf29ce484222325 for a new hash)
+ * @param data    The buffer to hash
+ * @param length  The length of the buffer
+ * @return        The new hash
+ */
+uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t length);
+
+
+/**
+ * Loads the frequencies of a file from its sidecar cache. The cache is used only if the device, inode, size and
+ * modification time of the file are the ones stored in the cache and the fingerprint of the file content matches.
+ *
+ * @param filename    The input file name
+ * @param huffman     The huffman struct. charFreq (and frequencies if n_sections is not 0) are filled on a hit
+ * @param n_sections  The number of section histograms needed (0 if only charFreq is needed)
+ * @param exact_only  If true, caches created from sampled frequencies are rejected
+ * @return            True if the frequencies were loaded
+ */
+bool loadFrequencyCache(const std::string& filename, ASCIIHuffman *huffman, uint8_t n_sections, bool exact_only);
+
+
+/**
+ * Stores the frequencies of a file to its sidecar cache (filename + FREQ_CACHE_EXTENSION)
+ *
+ * @param filename    The input file name
+ * @param huffman     The huffman struct with the frequencies
+ * @param n_sections  The number of section histograms to store (0 if only charFreq is known)
+ * @param exact       False if the frequencies are estimated (sampling mode)
+ */
+void storeFrequencyCache(const std::string& filename, ASCIIHuffman *huffman, uint8_t n_sections, bool exact);
+
+#endif
@@ -0,0 +1,277 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "fused.h"
+#include "huffman.h"
+#include "histogram.h"
+#include "bit_writer.h"
+
+//#define DEBUG_MODE
+
+
+/**
+ * Initialises a chunk and allocates the buffers for its characters and its huffman struct
+ *
+ * @param chunk  The chunk to initialise
+ */
+void initFusedChunk(FusedChunk *chunk) {
+    chunk->data = (uint8_t *) malloc(FUSED_CHUNK_SIZE);
+    chunk->huffman = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+    chunk->words = nullptr;
+    chunk->n_words = 0;
+    chunk->n_bits = 0;
+    chunk->n_chars = 0;
+    chunk->new_table = true;
+}
+
+
+/**
+ * Frees the buffers of a chunk
+ *
+ * @param chunk  The chunk to free
+ */
+void freeFusedChunk(FusedChunk *chunk) {
+    free(chunk->data);
+    free(chunk->huffman);
+    free(chunk->words);
+}
+
+
+/**
+ * Makes sure the words buffer of the chunk can hold n_bits. The encoded bits are grouped in 128 bit elements, so the
+ * number of words is always even.
+ *
+ * @param chunk   The chunk
+ * @param n_bits  The number of bits the buffer has to hold
+ * @return        The number of words of n_bits
+ */
+uint64_t reserveWords(FusedChunk *chunk, uint64_t n_bits) {
+    uint64_t n_words = (n_bits + 2 * WORD_BITS - 1) / (2 * WORD_BITS) * 2;
+
+    if (n_words > chunk->n_words) {
+        free(chunk->words);
+        chunk->words = (uint64_t *) malloc(n_words * sizeof(uint64_t));
+        chunk->n_words = n_words;
+    }
+
+    return n_words;
+}
+
+
+/**
+ * Counts the characters of the chunk to the charFreq of its huffman struct
+ *
+ * @param chunk  The chunk with the characters (data, n_chars)
+ */
+void countFusedChunk(FusedChunk *chunk) {
+    for (uint64_t &freq : chunk->huffman->charFreq) {
+        freq = 0;
+    }
+
+    countBytes(chunk->data, chunk->n_chars, chunk->huffman->charFreq);
+}
+
+
+/**
+ * Gives the counted chunk its table. The chunk gets a new table (which becomes the table of the stream) unless
+ * TABLE_REUSE is defined and its histogram did not drift from the table of the stream (see tableDrifted). The chunks
+ * must be passed in the order of the file.
+ *
+ * @param chunk  The counted chunk
+ * @param table  The table of the stream
+ */
+void chooseFusedTable(FusedChunk *chunk, FusedTable *table) {
+    ASCIIHuffman *huffman = chunk->huffman;
+
+#ifdef TABLE_REUSE
+    // The size of a new table is estimated with the current one (the tables of a stream have similar sizes)
+    if (!table->empty && !tableDrifted(huffman->charFreq, &table->huffman, table->redundancy,
+                                       huffmanTableSize(&table->huffman))) {
+        memcpy(huffman->symbols, table->huffman.symbols, sizeof(huffman->symbols));
+        chunk->new_table = false;
+
+        return;
+    }
+#endif
+
+    createHuffmanTree(huffman);
+    chunk->new_table = true;
+
+    memcpy(table->huffman.symbols, huffman->symbols, sizeof(huffman->symbols));
+    table->redundancy = tableRedundancy(huffman->charFreq, huffman);
+    table->empty = false;
+
+#ifdef DEBUG_MODE
+    std::cout << "New table with a redundancy of " << table->redundancy << " bits per character" << std::endl;
+#endif
+}
+
+
+/**
+ * Encodes the characters of the chunk to chunk->words with the table of the chunk. The number of encoded bits is known
+ * from the frequencies before encoding so the buffer is allocated once.
+ *
+ * @param chunk  The chunk with the characters (data, n_chars) and its table (chooseFusedTable)
+ */
+void encodeFusedChunk(FusedChunk *chunk) {
+    ASCIIHuffman *huffman = chunk->huffman;
+
+    chunk->n_bits = encodedBits(huffman->charFreq, huffman);
+
+    // The bit writer fills every word of the chunk, so the buffer is not cleared
+    BitWriter writer;
+    attachBitWriter(&writer, chunk->words, reserveWords(chunk, chunk->n_bits));
+
+    // The symbols up to 64 bits are copied to an array of words
+    uint64_t codes[256];
+    uint8_t lengths[256];
+
+    for (int i = 0; i < 256; ++i) {
+        codes[i] = huffman->symbols[i].symbol.lower().lower();
+        lengths[i] = huffman->symbols[i].symbol_length;
+    }
+
+    // The vector kernel encodes the chunk when every symbol fits VECTOR_CODE_MAX_LENGTH bits
+    uint32_t vector_codes[256];
+    uint32_t i = 0;
+
+    if (buildVectorCodes(huffman, vector_codes)) {
+        i = putBytesVector(&writer, chunk->data, chunk->n_chars, vector_codes);
+    }
+
+    for (; i < chunk->n_chars; ++i) {
+        uint8_t c = chunk->data[i];
+
+        if (lengths[c] <= WORD_BITS) {
+            putBits(&writer, codes[c], lengths[c]);
+
+        } else {
+            putCode(&writer, huffman->symbols[c].symbol, lengths[c]);
+        }
+    }
+
+    closeBitWriter(&writer);
+}
+
+
+/**
+ * Decodes the encoded bits of a chunk to chunk->data by walking the huffman tree of the chunk
+ *
+ * @param chunk  The chunk read with readFusedChunk
+ */
+void decodeFusedChunk(FusedChunk *chunk) {
+    // The huffman tree
+    HuffmanNode nodes[511];
+    uint16_t root_index = huffmanFromArray(chunk->huffman, nodes);
+
+    uint16_t node = root_index;
+    uint64_t bit_pos = 0;
+
+    for (uint32_t i = 0; i < chunk->n_chars; ++bit_pos) {
+        uint64_t bit = (chunk->words[(bit_pos / WORD_BITS) ^ 1] >> (WORD_BITS - 1 - bit_pos % WORD_BITS)) & 1;
+
+        node = bit == 0 ? nodes[node].left : nodes[node].right;
+
+        // The symbol is complete
+        if (nodes[node].isLeaf) {
+            chunk->data[i++] = nodes[node].ascii_index;
+            node = root_index;
+        }
+    }
+}
+
+
+/**
+ * Writes the header of a fused compressed file
+ *
+ * @param file       The compressed file
+ * @param file_size  The size of the original file
+ */
+void writeFusedHeader(FILE *file, uint64_t file_size) {
+    uint32_t chunk_size = FUSED_CHUNK_SIZE;
+
+    fwrite(&file_size, sizeof(file_size), 1, file);
+    fwrite(&chunk_size, sizeof(chunk_size), 1, file);
+}
+
+
+/**
+ * Reads the header of a fused compressed file
+ *
+ * @param file  The compressed file
+ * @return      The number of chunks in the file
+ */
+uint64_t readFusedHeader(FILE *file) {
+    uint64_t file_size = 0;
+    uint32_t chunk_size = 0;
+
+    fread(&file_size, sizeof(file_size), 1, file);
+    fread(&chunk_size, sizeof(chunk_size), 1, file);
+
+    if (chunk_size != FUSED_CHUNK_SIZE) {
+        std::cout << "The file was compressed with a chunk size of " << chunk_size << " bytes" << std::endl;
+        exit(-1);
+    }
+
+    return (file_size + chunk_size - 1) / chunk_size;
+}
+
+
+/**
+ * Writes an encoded chunk to the compressed file
+ *
+ * @param file   The compressed file
+ * @param chunk  The encoded chunk
+ */
+void writeFusedChunk(FILE *file, FusedChunk *chunk) {
+    uint8_t table_flag = chunk->new_table ? 1 : 0;
+
+    fwrite(&chunk->n_chars, sizeof(chunk->n_chars), 1, file);
+    fwrite(&table_flag, sizeof(table_flag), 1, file);
+
+    if (chunk->new_table) {
+        writeHuffmanTable(file, chunk->huffman);
+    }
+
+    fwrite(&chunk->n_bits, sizeof(chunk->n_bits), 1, file);
+
+    // Only whole 128 bit elements are written
+    uint64_t n_words = (chunk->n_bits + 2 * WORD_BITS - 1) / (2 * WORD_BITS) * 2;
+    fwrite(chunk->words, sizeof(chunk->words[0]), n_words, file);
+}
+
+
+/**
+ * Reads the next chunk of the compressed file. If the chunk has no table the table of the previous chunk is copied.
+ *
+ * @param file      The compressed file
+ * @param chunk     The chunk to fill
+ * @param previous  The previous chunk of the file (nullptr for the first chunk)
+ */
+void readFusedChunk(FILE *file, FusedChunk *chunk, const FusedChunk *previous) {
+    uint8_t table_flag = 0;
+
+    fread(&chunk->n_chars, sizeof(chunk->n_chars), 1, file);
+    fread(&table_flag, sizeof(table_flag), 1, file);
+
+    chunk->new_table = table_flag == 1;
+
+    if (chunk->new_table) {
+        readHuffmanTable(file, chunk->huffman, "");
+
+    } else if (previous != nullptr && previous != chunk) {
+        memcpy(chunk->huffman->symbols, previous->huffman->symbols, sizeof(chunk->huffman->symbols));
+    }
+
+    fread(&chunk->n_bits, sizeof(chunk->n_bits), 1, file);
+
+    reserveWords(chunk, chunk->n_bits);
+
+    uint64_t n_words = (chunk->n_bits + 2 * WORD_BITS - 1) / (2 * WORD_BITS) * 2;
+    fread(chunk->words, sizeof(chunk->words[0]), n_words, file);
+
+#ifdef DEBUG_MODE
+    std::cout << "Chunk: " << chunk->n_chars << " characters, " << chunk->n_bits << " bits" << std::endl;
+#endif
+}
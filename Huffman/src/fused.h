@@ -0,0 +1,137 @@
+#ifndef FUSED_H
+#define FUSED_H
+
+#include <cstdio>
+
+#include "structs.h"
+
+/*
+ * Fused mode compresses the file in a single pass. Every chunk is read once, counted, gets its own huffman table and is
+ * encoded while it is still in the cache. The compressed file has the following format:
+ *
+ *      Byte 0:7       The size of the original file (uint64_t)
+ *      Byte 8:11      The chunk size used to compress the file (uint32_t)
+ *
+ *      For every chunk:
+ *          uint32_t   The number of characters of the chunk
+ *          uint8_t    1 if a huffman table follows, 0 if the chunk uses the table of the previous chunk
+ *          table      The huffman table of the chunk (up to HUFFMAN_TABLE_SIZE bytes, see writeHuffmanTable)
+ *          uint64_t   The number of encoded bits of the chunk
+ *          data       The encoded bits in 128 bit elements (the same layout the other compressed files use)
+ *
+ * Every chunk is counted (countFusedChunk), gets its table in the order of the file (chooseFusedTable) and is encoded
+ * (encodeFusedChunk). Only the counting and the encoding of the chunks run in parallel. When TABLE_REUSE is defined a
+ * chunk keeps the table of the stream while its histogram does not drift from it, so neither the tree is built nor the
+ * table is stored for that chunk.
+ */
+
+
+typedef struct fused_chunk {
+    uint8_t *data = nullptr;          /// The characters of the chunk (FUSED_CHUNK_SIZE bytes)
+    uint32_t n_chars = 0;             /// The number of characters of the chunk
+
+    ASCIIHuffman *huffman = nullptr;  /// The huffman struct of the chunk
+    bool new_table = true;            /// True if the table of the chunk is written with it
+
+    uint64_t *words = nullptr;        /// The encoded bits of the chunk
+    uint64_t n_bits = 0;              /// The number of encoded bits
+    uint64_t n_words = 0;             /// The number of allocated words
+
+} FusedChunk;
+
+
+typedef struct fused_table {
+    ASCIIHuffman huffman;   /// The table of the last chunk that was stored with a table
+    double redundancy = 0;  /// The redundancy of the table on the histogram it was built from (see tableRedundancy)
+    bool empty = true;      /// True until the first chunk gets a table
+} FusedTable;
+
+
+/**
+ * Allocates the buffers of a chunk
+ *
+ * @param chunk  The chunk to initialise
+ */
+void initFusedChunk(FusedChunk *chunk);
+
+
+/**
+ * Frees the buffers of a chunk
+ *
+ * @param chunk  The chunk to free
+ */
+void freeFusedChunk(FusedChunk *chunk);
+
+
+/**
+ * Counts the characters of the chunk to the charFreq of its huffman struct
+ *
+ * @param chunk  The chunk with the characters (data, n_chars)
+ */
+void countFusedChunk(FusedChunk *chunk);
+
+
+/**
+ * Gives the counted chunk its table. The chunk gets a new table (which becomes the table of the stream) unless
+ * TABLE_REUSE is defined and its histogram did not drift from the table of the stream (see tableDrifted). The chunks
+ * must be passed in the order of the file.
+ *
+ * @param chunk  The counted chunk
+ * @param table  The table of the stream
+ */
+void chooseFusedTable(FusedChunk *chunk, FusedTable *table);
+
+
+/**
+ * Encodes the characters of the chunk to chunk->words with the table of the chunk
+ *
+ * @param chunk  The chunk with the characters (data, n_chars) and its table (chooseFusedTable)
+ */
+void encodeFusedChunk(FusedChunk *chunk);
+
+
+/**
+ * Decodes the encoded bits of a chunk to chunk->data
+ *
+ * @param chunk  The chunk read with readFusedChunk
+ */
+void decodeFusedChunk(FusedChunk *chunk);
+
+
+/**
+ * Writes the header of a fused compressed file
+ *
+ * @param file       The compressed file
+ * @param file_size  The size of the original file
+ */
+void writeFusedHeader(FILE *file, uint64_t file_size);
+
+
+/**
+ * Reads the header of a fused compressed file
+ *
+ * @param file  The compressed file
+ * @return      The number of chunks in the file
+ */
+uint64_t readFusedHeader(FILE *file);
+
+
+/**
+ * Writes an encoded chunk to the compressed file
+ *
+ * @param file   The compressed file
+ * @param chunk  The encoded chunk
+ */
+void writeFusedChunk(FILE *file, FusedChunk *chunk);
+
+
+/**
+ * Reads the next chunk of the compressed file. If the chunk has no table the table of the previous chunk is copied.
+ *
+ * @param file      The compressed file
+ * @param chunk     The chunk to fill
+ * @param previous  The previous chunk of the file (nullptr for the first chunk)
+ */
+void readFusedChunk(FILE *file, FusedChunk *chunk, const FusedChunk *previous);
+
+#endif
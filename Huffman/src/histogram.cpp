@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+
+#include "histogram.h"
+
+#define N_SUB_TABLES 4                         // The number of interleaved counting tables
+#define SUB_TABLE_SLICE (1024UL * 1024 * 1024)  // Bytes counted before the 32 bit sub-tables are flushed (1GB)
+
+
+/**
+ * Adds the 8 bytes of a word to the sub-tables. Neighbouring bytes go to different tables.
+ *
+ * @param sub_tables  The interleaved counting tables (N_SUB_TABLES tables)
+ * @param word        The 8 bytes to count
+ */
+static inline void countWord(uint32_t (*sub_tables)[256], uint64_t word) {
+    sub_tables[0][(uint8_t) word]++;
+    sub_tables[1][(uint8_t) (word >> 8)]++;
+    sub_tables[2][(uint8_t) (word >> 16)]++;
+    sub_tables[3][(uint8_t) (word >> 24)]++;
+    sub_tables[0][(uint8_t) (word >> 32)]++;
+    sub_tables[1][(uint8_t) (word >> 40)]++;
+    sub_tables[2][(uint8_t) (word >> 48)]++;
+    sub_tables[3][(uint8_t) (word >> 56)]++;
+}
+
+
+/**
+ * Merges the sub-tables to the 64 bit frequency array
+ *
+ * @param sub_tables     The interleaved counting tables
+ * @param n_tables       The number of sub-tables
+ * @param frequency_arr  The frequency array (256 elements)
+ */
+static inline void mergeSubTables(uint32_t (*sub_tables)[256], int n_tables, uint64_t *frequency_arr) {
+    for (int j = 0; j < 256; ++j) {
+        uint64_t sum = 0;
+
+        for (int t = 0; t < n_tables; ++t) {
+            sum += sub_tables[t][j];
+        }
+
+        frequency_arr[j] += sum;
+    }
+}
+
+
+/**
+ * Counts the frequency of every byte of a memory buffer and adds the counts to the frequency array. Incrementing a
+ * single table (charFreq[c]++) creates a store to load dependency every time the same byte appears twice in a row,
+ * which is very common in text. With N_SUB_TABLES tables the neighbouring bytes update different memory locations and
+ * the increments can run in parallel. The sub-tables are 32 bits wide to keep them in L1 and they are flushed to the 64
+ * bit frequency array every SUB_TABLE_SLICE bytes.
+ *
+ * @param data           The buffer to count
+ * @param length         The number of bytes in the buffer
+ * @param frequency_arr  The frequency array (256 elements) the counts are added to
+ */
+void countBytes(const uint8_t *data, uint64_t length, uint64_t *frequency_arr) {
+    uint32_t sub_tables[N_SUB_TABLES][256];
+
+    while (length > 0) {
+        // The number of bytes counted before flushing the sub-tables
+        uint64_t slice = length < SUB_TABLE_SLICE ? length : SUB_TABLE_SLICE;
+
+        memset(sub_tables, 0, sizeof(sub_tables));
+
+        uint64_t i = 0;
+
+        // Read 16 bytes at a time and spread them over the sub-tables
+        for (; i + 16 <= slice; i += 16) {
+            uint64_t w1;
+            uint64_t w2;
+
+            memcpy(&w1, data + i, sizeof(w1));
+            memcpy(&w2, data + i + 8, sizeof(w2));
+
+            countWord(sub_tables, w1);
+            countWord(sub_tables, w2);
+        }
+
+        // Count the remaining bytes one by one
+        for (; i < slice; ++i) {
+            sub_tables[0][data[i]]++;
+        }
+
+        mergeSubTables(sub_tables, N_SUB_TABLES, frequency_arr);
+
+        data += slice;
+        length -= slice;
+    }
+}
+
+
+/**
+ * Counts the frequency of every byte of a part of a file. The file is read in large aligned blocks and every block is
+ * passed to countBytes.
+ *
+ * @param file           The file to count the frequencies
+ * @param start_byte     The byte (inclusive, measuring from 0) from where to start counting in the file
+ * @param end_byte       The byte (exclusive, measuring from 0) to where to stop counting in the file
+ * @param frequency_arr  The frequency array (256 elements) the counts are added to
+ */
+void countFileRange(FILE *file, uint64_t start_byte, uint64_t end_byte, uint64_t *frequency_arr) {
+    // The read buffer. It is page aligned so the kernel can copy whole pages to it
+    auto *buffer = (uint8_t *) aligned_alloc(HIST_ALIGNMENT, HIST_BLOCK_SIZE);
+
+    fseek(file, (long) start_byte, SEEK_SET);  // Jump to the beginning of the section to count
+
+    uint64_t remaining = end_byte - start_byte;  // The number of bytes left to read from the file
+
+    // Let the kernel know the section is read from start to finish so the read ahead is more aggressive
+    posix_fadvise(fileno(file), (off_t) start_byte, (off_t) remaining, POSIX_FADV_SEQUENTIAL);
+
+    while (remaining > 0) {
+        size_t read_size = remaining < HIST_BLOCK_SIZE ? remaining : HIST_BLOCK_SIZE;
+
+        // Read a whole block from the file
+        size_t n_read = fread(buffer, sizeof(buffer[0]), read_size, file);
+
+        // The file is shorter than expected
+        if (n_read == 0) {
+            break;
+        }
+
+        countBytes(buffer, n_read, frequency_arr);
+
+        remaining -= n_read;
+    }
+
+    free(buffer);
+}
@@ -0,0 +1,33 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstdio>
+#include <cinttypes>
+
+#define HIST_BLOCK_SIZE (1024 * 1024)  // The number of bytes read from the file with every fread call (1MB)
+#define HIST_ALIGNMENT 4096            // The alignment of the read buffer (one page)
+
+
+/**
+ * Counts the frequency of every byte of a memory buffer and adds the counts to the frequency array. The counting is
+ * done in several interleaved sub-tables so that consecutive equal bytes do not wait on each other's increment.
+ *
+ * @param data           The buffer to count
+ * @param length         The number of bytes in the buffer
+ * @param frequency_arr  The frequency array (256 elements) the counts are added to
+ */
+void countBytes(const uint8_t *data, uint64_t length, uint64_t *frequency_arr);
+
+
+/**
+ * Counts the frequency of every byte of a part of a file. The file is read in large aligned blocks and every block is
+ * passed to countBytes.
+ *
+ * @param file           The file to count the frequencies
+ * @param start_byte     The byte (inclusive, measuring from 0) from where to start counting in the file
+ * @param end_byte       The byte (exclusive, measuring from 0) to where to stop counting in the file
+ * @param frequency_arr  The frequency array (256 elements) the counts are added to
+ */
+void countFileRange(FILE *file, uint64_t start_byte, uint64_t end_byte, uint64_t *frequency_arr);
+
+#endif
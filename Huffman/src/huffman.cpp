@@ -1,48 +1,26 @@
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sys/stat.h>
 
 #include "huffman.h"
+#include "code_builder.h"
+#include "freq_cache.h"
+#include "presets.h"
 
 //#define DEBUG_MODE
 
 
-/**
- * Initializes the leaf nodes of the tree.
- *
- * @param huffman  The ASCIIHuffman struct
- * @param nodes         The nodes array
- * @return              The index of the next node to be inserted in the array
- */
-uint16_t initializeTree(ASCIIHuffman *huffman, HuffmanNode *nodes) {
-    uint16_t nodes_index = 0;
-
-    // init the leaf nodes
-    for (int i = 0; i < 256; ++i) {
-        nodes[nodes_index].freq = huffman->charFreq[i];  // Character frequency
-        nodes[nodes_index].ascii_index = i;   // The character
-        nodes[nodes_index].isLeaf = true;     // These nodes are the leaf nodes of the tree
-        nodes[nodes_index].isInTree = false;  // The node is in the array, but it is not in the tree yet
-        nodes[nodes_index].left = -1;         // The index of the left child is -1 because there is no left child
-        nodes[nodes_index].right = -1;        // The index of the right child is -1 because there is no right child
-
-        nodes[nodes_index].leaf_symbol.symbol = 0;  // The huffman symbol initially is 0
-        nodes[nodes_index].leaf_symbol.symbol_length = 0;   // The symbol length is initially 0
-
-        // Increment the index of the tree array
-        nodes_index++;
-    }
-
-    // Return the index of the next node
-    return nodes_index;
-}
-
-
 /**
  * Prints the huffman tree
  *
  * @param nodes        The nodes array of the tree
  * @param nodes_index  The index of the last node in the tree
  */
-void printTree(HuffmanNode *nodes, uint16_t nodes_index) {
+template <typename CodeWord>
+void printTree(HuffmanNodeT<CodeWord> *nodes, uint16_t nodes_index) {
     printf("Huffman Tree: \n");
 
     for (int i = nodes_index; i >= 0; --i) {
@@ -58,164 +36,258 @@ void printTree(HuffmanNode *nodes, uint16_t nodes_index) {
     }
 }
 
+template void printTree<uint32_t>(HuffmanNodeT<uint32_t> *nodes, uint16_t nodes_index);
+template void printTree<uint64_t>(HuffmanNodeT<uint64_t> *nodes, uint16_t nodes_index);
+template void printTree<uint256_t>(HuffmanNodeT<uint256_t> *nodes, uint16_t nodes_index);
+
 
 /**
- * Shifts the bit by length to the left and adds the new bit in the msb position of the symbol
+ * The main part of the huffman algorithm. This function calculates the symbols of all the characters (the characters
+ * with a frequency of 0 get the longest symbols). The code lengths are calculated by huffmanCodeLengths in
+ * O(n log n) and the symbols are canonical.
  *
- * @param sym   Pointer to the symbol to update
- * @param bit   The bit to append
+ * @param asciiHuffman  The huffman struct with the character frequencies
  */
-void addBitToSymbol(Symbol *sym, uint8_t bit) {
+void createHuffmanTree(ASCIIHuffman *asciiHuffman) {
+#ifdef LENGTH_LIMITED_CODES
+    createLengthLimitedCodes(asciiHuffman, MAX_CODE_LENGTH);
+    return;
+#endif
 
-    // Left shift the symbol to make space for the new bit
-    sym->symbol = (sym->symbol << 1) + bit;
+    uint8_t lengths[256];
 
-    // Update the symbol length
-    sym->symbol_length += 1;
+    huffmanCodeLengths(asciiHuffman->charFreq, 256, lengths);
+    createCanonicalSymbols(asciiHuffman, lengths);
 }
 
 
 /**
- * Recursive function that updates the huffman symbols of the leaf nodes. The nodes are updated from the top to the
- * bottom so every time the function is called the new bit is added to the LSB of the sym.
+ * A package-merge list item. An item is a leaf (a character) or a package of two items of the list of the next level
+ */
+typedef struct merge_item {
+    uint64_t weight;  /// The frequency of the character or the sum of the weights of the package
+    int16_t leaf;     /// The character of a leaf or -1 for a package
+} MergeItem;
+
+
+/**
+ * Creates the symbols of a huffman struct with the package-merge algorithm. The symbols are the optimal prefix code
+ * where no symbol is longer than max_length bits. Every character gets a symbol (the characters with a frequency of 0
+ * get the longest ones).
  *
- * @param asciiHuffman  The final Huffman array
- * @param rootNode      The root node of the huffman tree
- * @param sym           The huffman symbol up to that depth
- * @param nodes         The array of the tree nodes
+ * @param huffman     The huffman struct with the character frequencies
+ * @param max_length  The maximum symbol length in bits (8 to 255)
  */
-void createSymbols(ASCIIHuffman *asciiHuffman, HuffmanNode *rootNode, Symbol sym, HuffmanNode *nodes) {
+void createLengthLimitedCodes(ASCIIHuffman *huffman, uint8_t max_length) {
+    // The characters sorted by frequency (insertion sort, the characters with the same frequency keep their order)
+    uint8_t order[256];
 
-    // Termination condition. If the node is a leaf node ...
-    if (rootNode->isLeaf) {
-        // And update the sym in the final huffman struct
-        asciiHuffman->symbols[rootNode->ascii_index] = sym;
-        rootNode->leaf_symbol = sym;
-        return;
+    for (int i = 0; i < 256; ++i) {
+        int j = i;
+
+        while (j > 0 && huffman->charFreq[order[j - 1]] > huffman->charFreq[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+
+        order[j] = i;
+    }
+
+    /*
+     * lists[0] is the list of the deepest level (max_length) and holds only the leaves. The list of every other level
+     * is the merge of the leaves with the packages (pairs) of the list of the level below. A list has less than 512
+     * items.
+     */
+    auto *lists = (MergeItem (*)[512]) malloc(max_length * sizeof(MergeItem[512]));
+    uint16_t list_size[256];
+
+    for (int i = 0; i < 256; ++i) {
+        lists[0][i].weight = huffman->charFreq[order[i]];
+        lists[0][i].leaf = order[i];
     }
 
-    // If the node is not a leaf node the function will be recursively called for the left and right child
+    list_size[0] = 256;
 
-    // The left and right symbols are created from the current sym...
-    Symbol left_symbol = sym;
-    Symbol right_symbol = sym;
+    for (int level = 1; level < max_length; ++level) {
+        const MergeItem *below = lists[level - 1];
+        uint16_t n_packages = list_size[level - 1] / 2;
 
-    // ... by appending the bit 0 to the left sym
-    addBitToSymbol(&left_symbol, 0);
+        uint16_t leaf = 0;
+        uint16_t package = 0;
+        uint16_t size = 0;
 
-    // ... and the bit 1 to the right sym
-    addBitToSymbol(&right_symbol, 1);
+        while (leaf < 256 || package < n_packages) {
+            uint64_t package_weight = package < n_packages ? below[2 * package].weight + below[2 * package + 1].weight : UINT64_MAX;
 
-    if (nodes[rootNode->left].isInTree) {
-        // The function is called recursively for the left ...
-        createSymbols(asciiHuffman, &nodes[rootNode->left], left_symbol, nodes);
+            if (leaf < 256 && (package == n_packages || lists[0][leaf].weight <= package_weight)) {
+                lists[level][size++] = lists[0][leaf++];
+
+            } else {
+                lists[level][size].weight = package_weight;
+                lists[level][size++].leaf = -1;
+                package++;
+            }
+        }
+
+        list_size[level] = size;
     }
 
-    if (nodes[rootNode->right].isInTree) {
-        // ...and for the right child
-        createSymbols(asciiHuffman, &nodes[rootNode->right], right_symbol, nodes);
+    /*
+     * The first 2 * 256 - 2 items of the top list are selected. Every selected package selects the next two items of the
+     * list below. The length of a symbol is the number of times its leaf is selected.
+     */
+    uint8_t lengths[256] = {0};
+    uint16_t selected = 2 * 256 - 2;
+
+    for (int level = max_length - 1; level >= 0 && selected > 0; --level) {
+        uint16_t n_packages = 0;
+
+        for (int i = 0; i < selected; ++i) {
+            if (lists[level][i].leaf >= 0) {
+                lengths[lists[level][i].leaf]++;
+
+            } else {
+                n_packages++;
+            }
+        }
+
+        selected = 2 * n_packages;
     }
+
+    free(lists);
+
+    createCanonicalSymbols(huffman, lengths);
 }
 
 
 /**
- * The main part of the huffman algorithm. This function calculates all the symbols for the characters that exist (have
- * a frequency of more than 1)
- * @param asciiHuffman  The huffman struct with the character frequencies
+ * Creates canonical symbols from the symbol lengths. The symbols of the same length are consecutive numbers ordered by
+ * character and every symbol is bigger than the symbols of the shorter lengths, so only the lengths define the table.
+ *
+ * @param huffman  The huffman struct the symbols are stored to
+ * @param lengths  The length of the symbol of every character (256 elements)
  */
-void createHuffmanTree(ASCIIHuffman *asciiHuffman) {
-    /*
-     * The maximum nodes a huffman tree with 256 different symbols can have is 511. The nodes array holds all the nodes
-     * of the tree. The symbols are updated as the tree builds.
-     *
-     */
-    HuffmanNode nodes[511];
-    uint16_t nodes_index;  // The index of the last node inserted
+void createCanonicalSymbols(ASCIIHuffman *huffman, const uint8_t *lengths) {
+    uint256_t codes[256];
 
-    // Init the array with the leaf nodes
-    nodes_index = initializeTree(asciiHuffman, nodes);
+    canonicalCodes(lengths, 256, codes);
 
-    // The nodes in the array that are not in the tree
-    uint16_t remaining_nodes = nodes_index;
+    for (int i = 0; i < 256; ++i) {
+        huffman->symbols[i].symbol = codes[i];
+        huffman->symbols[i].symbol_length = lengths[i];
+    }
 
-    // find the nodes with the two smallest frequencies in the nodes array.
+#ifdef DEBUG_MODE
+    for (int i = 0; i < 256; ++i) {
+        std::cout << "char: " << i << ", len: " << unsigned(lengths[i]) << ", sym: " << std::hex
+                  << huffman->symbols[i].symbol << std::dec << std::endl;
+    }
+#endif
+}
 
-    while (remaining_nodes > 1) {
 
-        uint16_t s1_index = -1;  // The smallest frequency index in the frequency array
-        uint16_t s2_index = -1;  // The second-smallest frequency index in the frequency array
+/**
+ * Calculates the number of bits needed to encode the characters of a frequency array with the symbols of the huffman
+ * struct
+ *
+ * @param frequency_arr  The frequency array (256 elements)
+ * @param huffman        The huffman struct with the symbols
+ * @return               The number of encoded bits
+ */
+uint64_t encodedBits(const uint64_t *frequency_arr, const ASCIIHuffman *huffman) {
+    uint64_t n_bits = 0;
 
-        // The smallest frequencies at each point of the algorithm
-        uint64_t s1_freq = UINT64_MAX;
-        uint64_t s2_freq = UINT64_MAX;
+    for (int i = 0; i < 256; ++i) {
+        n_bits += frequency_arr[i] * huffman->symbols[i].symbol_length;
+    }
 
-        // find the first and second-smallest indexes
-        for (int i = 0; i < nodes_index; ++i) {
+    return n_bits;
+}
 
-            // If the node is not in the tree already...
-            if (!nodes[i].isInTree) {
-                // Read the current frequency from memory
-                unsigned int freq = nodes[i].freq;
 
-                if (freq < s1_freq) {
-                    s2_index = s1_index;
-                    s2_freq = s1_freq;
+/**
+ * Calculates the redundancy of a table on a histogram: the bits per character the symbols cost above the entropy of the
+ * histogram (the cross entropy of the histogram against the symbol lengths minus its entropy)
+ *
+ * @param frequency_arr  The histogram (256 elements)
+ * @param huffman        The huffman struct with the symbols
+ * @return               The redundancy in bits per character (0 for an empty histogram)
+ */
+double tableRedundancy(const uint64_t *frequency_arr, const ASCIIHuffman *huffman) {
+    uint64_t n_chars = 0;
 
-                    s1_index = i;
-                    s1_freq = freq;
+    for (int i = 0; i < 256; ++i) {
+        n_chars += frequency_arr[i];
+    }
 
-                } else if (freq < s2_freq) {
-                    s2_index = i;
-                    s2_freq = freq;
-                }
-            }
-        }
+    if (n_chars == 0) {
+        return 0;
+    }
 
-        // Create a new node
-        nodes[nodes_index].freq = s1_freq + s2_freq;  // The sum of the children frequencies
-        nodes[nodes_index].isLeaf = false;            // This is not a leaf node
-        nodes[nodes_index].isInTree = false;          // The node is in the array, but it is not in the tree yet
-        nodes[nodes_index].left = s1_index;           // The index of the left child
-        nodes[nodes_index].right = s2_index;          // The index of the right child
+    // Every character costs its symbol length instead of -log2(p) bits
+    double redundancy = 0;
 
-        // Update the child nodes
-        nodes[s1_index].isInTree = true;  // The first child is in the tree
-        nodes[s2_index].isInTree = true;  // The second child is in the tree
+    for (int i = 0; i < 256; ++i) {
+        if (frequency_arr[i] != 0) {
+            double p = (double) frequency_arr[i] / (double) n_chars;
+            redundancy += p * (huffman->symbols[i].symbol_length + log2(p));
+        }
+    }
 
-        remaining_nodes--;  // Two old nodes are in the tree and one new is not
-        nodes_index++;  // Increment the index of the tree array
+    return redundancy;
+}
 
-    }
 
-    // Initial symbol all zero
-    Symbol sym;
+/**
+ * Decides if the table of a stream of chunks has to be rebuilt for the histogram of the next chunk (TABLE_REUSE). The
+ * drift is the redundancy of the table on the histogram minus the redundancy it had on the histogram it was built from.
+ * The table is rebuilt when the drift is more than TABLE_DRIFT_THRESHOLD bits per character and the extra bits pay for
+ * storing the new table (table_size bytes).
+ *
+ * @param frequency_arr     The histogram of the next chunk (256 elements)
+ * @param huffman           The huffman struct with the current table
+ * @param built_redundancy  The redundancy of the current table on the histogram it was built from
+ * @param table_size        The size of the new table in the compressed file in bytes
+ * @return                  True if the table has to be rebuilt
+ */
+bool tableDrifted(const uint64_t *frequency_arr, const ASCIIHuffman *huffman, double built_redundancy,
+                  uint32_t table_size) {
+    uint64_t n_chars = 0;
 
-    sym.symbol_length = 0;
-    sym.symbol = 0;
+    for (int i = 0; i < 256; ++i) {
+        n_chars += frequency_arr[i];
+    }
 
-    // After the tree is complete all the symbols are updated
-    createSymbols(asciiHuffman, &nodes[nodes_index - 1], sym, nodes);
+    double drift = tableRedundancy(frequency_arr, huffman) - built_redundancy;
 
 #ifdef DEBUG_MODE
-    printTree(nodes, nodes_index - 1);
+    std::cout << "Table drift: " << drift << " bits per character" << std::endl;
 #endif
+
+    return drift > TABLE_DRIFT_THRESHOLD && drift * (double) n_chars > 8.0 * table_size;
 }
 
 
 /**
- * Creates a huffman tree from an array with the huffman symbols. The depth of every symbol is determined from the
- * number of bits is has. The more bits the deeper on the tree
+ * Creates a huffman tree from an array with the huffman symbols. Every symbol is inserted from the root following its
+ * bits (0 left, 1 right) and the missing internal nodes are created on the way, so the tree is built in time linear to
+ * the total length of the symbols. The leaf of character i is tree[i]. The code word of the nodes must fit the longest
+ * symbol (see codeWordWidth).
  *
  * @param asciiHuffman  The symbols array
  * @param tree          The array that holds all the nodes
  * @return              The index of the top node
  */
-uint16_t huffmanFromArray(ASCIIHuffman *huffman, HuffmanNode *tree) {
+template <typename CodeWord>
+uint16_t huffmanFromArray(ASCIIHuffman *huffman, HuffmanNodeT<CodeWord> *tree) {
+    SymbolT<CodeWord> symbols[256];
+    narrowSymbols(huffman, symbols);
+
     uint16_t tree_index = 0;
 
     // Create all the leaf nodes
     for (int i = 0; i < 256; ++i) {
-        tree[tree_index].leaf_symbol = huffman->symbols[i];     // The huffman symbol initially is 0
+        tree[tree_index].leaf_symbol = symbols[i];  // The huffman symbol of the character
         tree[tree_index].ascii_index = i;   // The character
         tree[tree_index].isLeaf = true;     // These nodes are the leaf nodes of the tree
         tree[tree_index].isInTree = false;  // The node is in the array, but it is not in the tree yet
@@ -225,64 +297,595 @@ uint16_t huffmanFromArray(ASCIIHuffman *huffman, HuffmanNode *tree) {
         tree_index++;  // increment the index
     }
 
-    uint16_t ind1;  // index of the first child node
-    uint16_t ind2;  // index of the second child node
-    uint8_t max_l;  // the length of the biggest symbol
+    // The root node has the empty symbol
+    uint16_t root_index = tree_index++;
 
-    do {
-        // reset the values
-        ind1 = 0xffff;  // No node with index 0xffff can exist
-        ind2 = 0xffff;
-        max_l = 0;
+    tree[root_index].leaf_symbol.symbol = 0;
+    tree[root_index].leaf_symbol.symbol_length = 0;
+    tree[root_index].isLeaf = false;
+    tree[root_index].isInTree = true;
+    tree[root_index].left = -1;
+    tree[root_index].right = -1;
 
-        // find the symbol with the maximum length
-        for (int i = 0; i < tree_index; ++i) {
-            if (!tree[i].isInTree){
-                if (tree[i].leaf_symbol.symbol_length > max_l) {
-                    max_l = tree[i].leaf_symbol.symbol_length;
-                    ind1 = i;
-                }
+    for (int i = 0; i < 256; ++i) {
+        const SymbolT<CodeWord> &symbol = symbols[i];
+
+        if (symbol.symbol_length == 0) {
+            continue;
+        }
+
+        uint16_t node = root_index;
+
+        for (int bit = symbol.symbol_length - 1; bit >= 0; --bit) {
+            uint16_t *child = codeBit(symbol.symbol, bit) ? &tree[node].right : &tree[node].left;
+
+            // The last bit leads to the leaf of the character
+            if (bit == 0) {
+                *child = i;
+                tree[i].isInTree = true;
+                break;
             }
+
+            // Create the internal node if it does not exist. Its symbol is the prefix of the symbol up to this bit
+            if (*child == 0xffff) {
+                tree[tree_index].leaf_symbol.symbol = symbol.symbol >> bit;
+                tree[tree_index].leaf_symbol.symbol_length = symbol.symbol_length - bit;
+                tree[tree_index].isLeaf = false;
+                tree[tree_index].isInTree = true;
+                tree[tree_index].left = -1;
+                tree[tree_index].right = -1;
+
+                *child = tree_index++;
+            }
+
+            node = *child;
         }
+    }
 
-        // Find the neighbour symbol. The neighbor symbol has the same length and only differs on the last bit
-        for (int i = 0; i < tree_index; ++i) {
-            if (!tree[i].isInTree && i != ind1 && tree[i].leaf_symbol.symbol_length == max_l) {
-                if ((tree[ind1].leaf_symbol.symbol >> 1) == (tree[i].leaf_symbol.symbol >> 1)) {
-                    ind2 = i;
-                    break;  // once the symbol is found break the loop
-                }
+    // The return value is the index of the root node
+    return root_index;
+}
+
+template uint16_t huffmanFromArray<uint32_t>(ASCIIHuffman *huffman, HuffmanNodeT<uint32_t> *tree);
+template uint16_t huffmanFromArray<uint64_t>(ASCIIHuffman *huffman, HuffmanNodeT<uint64_t> *tree);
+template uint16_t huffmanFromArray<uint256_t>(ASCIIHuffman *huffman, HuffmanNodeT<uint256_t> *tree);
+
+
+/**
+ * Finds the narrowest code word that fits every symbol of a huffman struct
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @return         The width of the code word in bits (32, 64 or 256)
+ */
+uint16_t codeWordWidth(const ASCIIHuffman *huffman) {
+    uint8_t max_length = 0;
+
+    for (const Symbol &symbol : huffman->symbols) {
+        if (symbol.symbol_length > max_length) {
+            max_length = symbol.symbol_length;
+        }
+    }
+
+    if (max_length <= 32) {
+        return 32;
+    }
+
+    return max_length <= 64 ? 64 : 256;
+}
+
+
+/**
+ * Copies the symbols of a huffman struct to an array of narrower code words. The code word must fit the longest symbol
+ * (see codeWordWidth).
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @param symbols  The narrow symbols (256 elements)
+ */
+template <typename CodeWord>
+void narrowSymbols(const ASCIIHuffman *huffman, SymbolT<CodeWord> *symbols) {
+    for (int i = 0; i < 256; ++i) {
+        symbols[i].symbol = (CodeWord) huffman->symbols[i].symbol;
+        symbols[i].symbol_length = huffman->symbols[i].symbol_length;
+    }
+}
+
+template void narrowSymbols<uint32_t>(const ASCIIHuffman *huffman, SymbolT<uint32_t> *symbols);
+template void narrowSymbols<uint64_t>(const ASCIIHuffman *huffman, SymbolT<uint64_t> *symbols);
+template void narrowSymbols<uint256_t>(const ASCIIHuffman *huffman, SymbolT<uint256_t> *symbols);
+
+
+/**
+ * Encodes the 256 symbol lengths with run length encoding (see TABLE_CANONICAL)
+ *
+ * @param lengths  The symbol lengths
+ * @param encoded  The buffer of the encoded lengths (at least 258 bytes)
+ * @return         The number of encoded bytes
+ */
+uint16_t encodeLengths(const uint8_t *lengths, uint8_t *encoded) {
+    uint16_t size = 0;
+    int i = 0;
+
+    while (i < 256) {
+        // Find the run of the same length that starts at i
+        int run = 1;
+
+        while (i + run < 256 && run < 130 && lengths[i + run] == lengths[i]) {
+            run++;
+        }
+
+        if (run >= 3) {
+            encoded[size++] = run + 125;
+            encoded[size++] = lengths[i];
+            i += run;
+
+            continue;
+        }
+
+        // Copy the lengths up to the next run of 3 (or 128 lengths)
+        int literals = 0;
+
+        while (i + literals < 256 && literals < 128) {
+            if (i + literals + 2 < 256 && lengths[i + literals] == lengths[i + literals + 1] &&
+                lengths[i + literals] == lengths[i + literals + 2]) {
+                break;
             }
+
+            literals++;
+        }
+
+        encoded[size++] = literals - 1;
+        memcpy(&encoded[size], &lengths[i], literals);
+
+        size += literals;
+        i += literals;
+    }
+
+    return size;
+}
+
+
+/**
+ * Decodes the symbol lengths encoded by encodeLengths
+ *
+ * @param encoded  The encoded lengths
+ * @param size     The number of encoded bytes
+ * @param lengths  The symbol lengths (256 elements)
+ * @return         True if the encoded bytes hold exactly the 256 lengths
+ */
+bool decodeLengths(const uint8_t *encoded, uint16_t size, uint8_t *lengths) {
+    int n_lengths = 0;
+    uint16_t i = 0;
+
+    while (i < size && n_lengths < 256) {
+        uint8_t control = encoded[i++];
+
+        int count = control < 128 ? control + 1 : control - 125;
+
+        if (n_lengths + count > 256 || i + (control < 128 ? count : 1) > size) {
+            break;
+        }
+
+        if (control < 128) {
+            memcpy(&lengths[n_lengths], &encoded[i], count);
+            i += count;
+
+        } else {
+            memset(&lengths[n_lengths], encoded[i++], count);
+        }
+
+        n_lengths += count;
+    }
+
+    return n_lengths == 256;
+}
+
+
+/**
+ * Writes a huffman table to a file. If the huffman struct has a preset_id only the id of the preset is written and if
+ * it has a table_id only a reference to the shared table is written. Otherwise the symbol lengths are written if
+ * CANONICAL_TABLES is defined (the symbols must be canonical) or the full table (every symbol followed by its length)
+ *
+ * @param file     The file pointer
+ * @param huffman  The huffman struct containing all the symbols
+ * @return         The number of bytes written
+ */
+uint32_t writeHuffmanTable(FILE *file, const ASCIIHuffman *huffman) {
+#ifdef CANONICAL_TABLES
+    uint8_t kind = huffman->table_id != 0 ? TABLE_REFERENCE : TABLE_CANONICAL;
+#else
+    uint8_t kind = huffman->table_id != 0 ? TABLE_REFERENCE : TABLE_FULL;
+#endif
+
+    if (huffman->preset_id != 0) {
+        kind = TABLE_PRESET_ID;
+    }
+
+    fwrite(&kind, sizeof(kind), 1, file);
+
+    if (kind == TABLE_PRESET_ID) {
+        fwrite(&huffman->preset_id, sizeof(huffman->preset_id), 1, file);
+
+        return TABLE_PRESET_ID_SIZE;
+    }
+
+    if (kind == TABLE_REFERENCE) {
+        fwrite(&huffman->table_id, sizeof(huffman->table_id), 1, file);
+
+        return TABLE_REFERENCE_SIZE;
+    }
+
+    if (kind == TABLE_CANONICAL) {
+        uint8_t lengths[256];
+        uint8_t encoded[258];
+
+        for (int i = 0; i < 256; ++i) {
+            lengths[i] = huffman->symbols[i].symbol_length;
         }
 
-        /*
-         * The parent node has a hypothetical symbol that is 1 bit less than it's children.
-         * The bit missing is thew last bit of the children's symbol
-         */
-        tree[tree_index].leaf_symbol.symbol = tree[ind1].leaf_symbol.symbol >> 1;
-        tree[tree_index].leaf_symbol.symbol_length = tree[ind1].leaf_symbol.symbol_length - 1;
+        uint16_t size = encodeLengths(lengths, encoded);
+
+        fwrite(&size, sizeof(size), 1, file);
+        fwrite(encoded, sizeof(encoded[0]), size, file);
+
+        return 1 + sizeof(size) + size;
+    }
 
-        tree[tree_index].isLeaf = false;     // This is not a leaf node
-        tree[tree_index].isInTree = false;   // The node is in the array, but it is not in the tree yet
+    for (const Symbol &symbol : huffman->symbols) {
+        fwrite(&symbol.symbol, sizeof(symbol.symbol), 1, file);
+        fwrite(&symbol.symbol_length, sizeof(symbol.symbol_length), 1, file);
+    }
 
-        if (ind2 != 0xffff) {
-            if (tree[ind1].leaf_symbol.symbol < tree[ind2].leaf_symbol.symbol) {
-                tree[tree_index].left = ind1;   // The index of the left child is the index of the node with the smaller symbol
-                tree[tree_index].right = ind2;  // The index of the right child is the index of the node with the bigger symbol
+    return HUFFMAN_TABLE_SIZE;
+}
+
+
+/**
+ * Returns the name of a shared table file. The table is stored in the directory of the compressed file
+ *
+ * @param filename  The name of the compressed file
+ * @param table_id  The id of the table
+ * @return          The name of the table file
+ */
+std::string sharedTableName(const std::string& filename, uint64_t table_id) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 SHARED_TABLE_EXTENSION, table_id);
+
+    size_t separator = filename.find_last_of('/');
+
+    return separator == std::string::npos ? std::string(name) : filename.substr(0, separator + 1) + name;
+}
+
+
+/**
+ * Checks that the symbols of a table read from a file are a prefix code that huffmanFromArray can build in its 511
+ * nodes (the 256 leaves, the root and up to 254 internal nodes). The symbols are inserted to a tree of the internal
+ * nodes the same way huffmanFromArray inserts them.
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @return         True if the table is valid
+ */
+static bool validHuffmanTable(const ASCIIHuffman *huffman) {
+    // The children of the internal nodes (node 0 is the root). A missing child is 0 and a leaf is -1
+    int16_t children[255][2] = {};
+    int16_t n_nodes = 1;
+
+    for (const Symbol &symbol : huffman->symbols) {
+        int16_t node = 0;
+
+        for (int bit = symbol.symbol_length - 1; bit >= 0; --bit) {
+            int16_t &child = children[node][codeBit(symbol.symbol, bit)];
+
+            // A symbol must not be the prefix of another symbol
+            if (child == -1 || (bit == 0 && child != 0)) {
+                return false;
+            }
+
+            if (bit == 0) {
+                child = -1;
 
             } else {
-                tree[tree_index].left = ind2;   // The index of the left child is the index of the node with the smaller symbol
-                tree[tree_index].right = ind1;  // The index of the right child is the index of the node with the bigger symbol
+                if (child == 0) {
+                    if (n_nodes == 255) {
+                        return false;
+                    }
+
+                    child = n_nodes++;
+                }
+
+                node = child;
             }
+        }
+    }
+
+    return true;
+}
 
-            // put the two nodes in the tree
-            tree[ind1].isInTree = true;
-            tree[ind2].isInTree = true;
+
+/**
+ * Reads the symbols of a full or a canonical table after its kind. Any other kind is a corrupted table
+ *
+ * @param file      The file pointer (after the kind of the table)
+ * @param kind      The kind of the table
+ * @param huffman   The huffman struct the symbols are stored to
+ * @param filename  The name of the file (printed if the table is corrupted)
+ * @return          The number of bytes of the table (with its kind)
+ */
+static uint32_t readSymbolTable(FILE *file, uint8_t kind, ASCIIHuffman *huffman, const std::string& filename) {
+    uint32_t table_size = HUFFMAN_TABLE_SIZE;
+
+    if (kind == TABLE_CANONICAL) {
+        uint16_t size = 0;
+        uint8_t encoded[258];
+        uint8_t lengths[256];
+
+        fread(&size, sizeof(size), 1, file);
+
+        if (size > sizeof(encoded) || fread(encoded, sizeof(encoded[0]), size, file) != size ||
+            !decodeLengths(encoded, size, lengths)) {
+            std::cout << "The canonical huffman table of " << filename << " is corrupted" << std::endl;
+            exit(-1);
         }
 
-        tree_index++;
-    } while (tree[tree_index - 1].leaf_symbol.symbol_length != 0);  // The only node with symbol length 0 is the root node
+        createCanonicalSymbols(huffman, lengths);
 
-    // The return value is the index of the root node
-    return tree_index - 1;
-}
\ No newline at end of file
+        table_size = 1 + sizeof(size) + size;
+
+    } else if (kind == TABLE_FULL) {
+        for (Symbol &symbol : huffman->symbols) {
+            fread(&symbol.symbol, sizeof(symbol.symbol), 1, file);
+            fread(&symbol.symbol_length, sizeof(symbol.symbol_length), 1, file);
+        }
+
+    } else {
+        std::cout << "The huffman table of " << filename << " is not a full or a canonical table (kind "
+                  << unsigned(kind) << ")" << std::endl;
+        exit(-1);
+    }
+
+    // The lengths of a canonical table or the symbols of a full table may not be a prefix code
+    if (!validHuffmanTable(huffman)) {
+        std::cout << "The huffman table of " << filename << " is not a valid prefix code" << std::endl;
+        exit(-1);
+    }
+
+    return table_size;
+}
+
+
+/**
+ * Reads a huffman table written by writeHuffmanTable. A reference is resolved by reading the shared table file stored
+ * next to the file and a preset id by the built in preset
+ *
+ * @param file      The file pointer
+ * @param huffman   The huffman struct the symbols are stored to
+ * @param filename  The name of the file (used to find the shared tables)
+ * @return          The number of bytes read from the file
+ */
+uint32_t readHuffmanTable(FILE *file, ASCIIHuffman *huffman, const std::string& filename) {
+    uint8_t kind = TABLE_FULL;
+
+    fread(&kind, sizeof(kind), 1, file);
+
+    if (kind == TABLE_PRESET_ID) {
+        uint8_t preset_id = 0;
+        fread(&preset_id, sizeof(preset_id), 1, file);
+
+        const TablePreset *preset = findPresetById(preset_id);
+
+        if (preset == nullptr) {
+            std::cout << "The table preset " << unsigned(preset_id) << " is not built into this binary" << std::endl;
+            exit(-1);
+        }
+
+        createCanonicalSymbols(huffman, preset->lengths);
+        huffman->preset_id = preset_id;
+
+        return TABLE_PRESET_ID_SIZE;
+    }
+
+    if (kind == TABLE_REFERENCE) {
+        uint64_t table_id = 0;
+        fread(&table_id, sizeof(table_id), 1, file);
+
+        std::string table_name = sharedTableName(filename, table_id);
+        FILE *table = fopen(table_name.c_str(), "rb");
+
+        if (table == nullptr) {
+            std::cout << "The shared table " << table_name << " was not found" << std::endl;
+            exit(-1);
+        }
+
+        // The shared table file holds the symbols of a full or a canonical table. A reference or a preset id in it is
+        // a corrupted file (a reference could lead back to the file itself)
+        uint8_t shared_kind = TABLE_REFERENCE;
+        fread(&shared_kind, sizeof(shared_kind), 1, table);
+
+        readSymbolTable(table, shared_kind, huffman, table_name);
+        fclose(table);
+
+        huffman->table_id = table_id;
+
+        return TABLE_REFERENCE_SIZE;
+    }
+
+    return readSymbolTable(file, kind, huffman, filename);
+}
+
+
+/**
+ * Calculates the number of bytes writeHuffmanTable writes for a huffman struct
+ *
+ * @param huffman  The huffman struct containing all the symbols
+ * @return         The size of the table in bytes
+ */
+uint32_t huffmanTableSize(const ASCIIHuffman *huffman) {
+    if (huffman->preset_id != 0) {
+        return TABLE_PRESET_ID_SIZE;
+    }
+
+    if (huffman->table_id != 0) {
+        return TABLE_REFERENCE_SIZE;
+    }
+
+#ifdef CANONICAL_TABLES
+    uint8_t lengths[256];
+    uint8_t encoded[258];
+
+    for (int i = 0; i < 256; ++i) {
+        lengths[i] = huffman->symbols[i].symbol_length;
+    }
+
+    return 1 + sizeof(uint16_t) + encodeLengths(lengths, encoded);
+#else
+    return HUFFMAN_TABLE_SIZE;
+#endif
+}
+
+
+/**
+ * Chooses the table of a section (SECTION_TABLES). A table is created from the frequencies of the section and it is
+ * used if the bytes it saves are more than its size (huffmanTableSize), otherwise the section uses the global table.
+ *
+ * @param huffman      The huffman struct with the global table
+ * @param frequencies  The frequencies of the section (256 elements)
+ * @return             The global huffman struct or a new one (free it) with the table of the section
+ */
+ASCIIHuffman *chooseSectionTable(ASCIIHuffman *huffman, const uint64_t *frequencies) {
+    auto *section = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+
+    memcpy(section->charFreq, frequencies, sizeof(section->charFreq));
+    createHuffmanTree(section);
+
+    uint64_t global_bits = encodedBits(frequencies, huffman);
+    uint64_t section_bits = encodedBits(frequencies, section);
+
+    // The bytes saved by the section table must pay for the table
+    if (section_bits >= global_bits || (global_bits - section_bits) / 8 <= huffmanTableSize(section)) {
+        free(section);
+        return huffman;
+    }
+
+#ifdef DEBUG_MODE
+    std::cout << "Section table saves " << (global_bits - section_bits) / 8 << " bytes for "
+              << huffmanTableSize(section) << " table bytes" << std::endl;
+#endif
+
+    return section;
+}
+
+
+/**
+ * Writes the tables of the sections after the global table (SECTION_TABLES). Every section has a flag (uint8_t) that
+ * is 1 if the table of the section follows and 0 if the section uses the global table.
+ *
+ * @param file            The file pointer
+ * @param huffman         The huffman struct with the global table
+ * @param section_tables  The table of every section (chooseSectionTable)
+ * @param n_sections      The number of sections
+ * @return                The number of bytes written
+ */
+uint32_t writeSectionTables(FILE *file, const ASCIIHuffman *huffman, ASCIIHuffman **section_tables, uint8_t n_sections) {
+    uint32_t size = 0;
+
+    for (int i = 0; i < n_sections; ++i) {
+        uint8_t has_table = section_tables[i] != huffman;
+
+        fwrite(&has_table, sizeof(has_table), 1, file);
+        size += sizeof(has_table);
+
+        if (has_table) {
+            size += writeHuffmanTable(file, section_tables[i]);
+        }
+    }
+
+    return size;
+}
+
+
+/**
+ * Reads the tables of the sections written by writeSectionTables
+ *
+ * @param file            The file pointer
+ * @param huffman         The huffman struct with the global table
+ * @param section_tables  The table of every section. A section without a table gets the global huffman struct, the
+ *                        others get a new one (free it)
+ * @param n_sections      The number of sections
+ * @param filename        The name of the file (used to find the shared tables)
+ * @return                The number of bytes read from the file
+ */
+uint32_t readSectionTables(FILE *file, ASCIIHuffman *huffman, ASCIIHuffman **section_tables, uint8_t n_sections,
+                           const std::string& filename) {
+    uint32_t size = 0;
+
+    for (int i = 0; i < n_sections; ++i) {
+        uint8_t has_table = 0;
+
+        fread(&has_table, sizeof(has_table), 1, file);
+        size += sizeof(has_table);
+
+        section_tables[i] = huffman;
+
+        if (has_table) {
+            section_tables[i] = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+            size += readHuffmanTable(file, section_tables[i], filename);
+        }
+    }
+
+    return size;
+}
+
+
+/**
+ * Calculates the id of a table (the FNV-1a hash of its symbols). The id is never 0
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @return         The id of the table
+ */
+uint64_t huffmanTableId(const ASCIIHuffman *huffman) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (const Symbol &symbol : huffman->symbols) {
+        uint8_t code[sizeof(uint256_t)];
+        memcpy(code, &symbol.symbol, sizeof(code));
+
+        hash = fnv1a(hash, code, sizeof(code));
+        hash = fnv1a(hash, &symbol.symbol_length, sizeof(symbol.symbol_length));
+    }
+
+    return hash == 0 ? 1 : hash;
+}
+
+
+/**
+ * Stores a shared table next to a compressed file. The table file is named after the table id and it is written only
+ * if it does not exist. It holds a full table (a canonical table with CANONICAL_TABLES)
+ *
+ * @param filename  The name of the compressed file
+ * @param huffman   The huffman struct with the symbols and the table_id
+ */
+void storeSharedTable(const std::string& filename, const ASCIIHuffman *huffman) {
+    std::string table_name = sharedTableName(filename, huffman->table_id);
+    struct stat table_stat{};
+
+    if (stat(table_name.c_str(), &table_stat) == 0) {
+        return;
+    }
+
+    FILE *table = fopen(table_name.c_str(), "wb");
+
+    if (table == nullptr) {
+        std::cout << "Could not create the shared table " << table_name << std::endl;
+        exit(-1);
+    }
+
+    // The table file holds the symbols of the table, not a reference to itself
+    ASCIIHuffman *shared = (ASCIIHuffman *) malloc(sizeof(ASCIIHuffman));
+    memcpy(shared->symbols, huffman->symbols, sizeof(shared->symbols));
+    shared->table_id = 0;
+    shared->preset_id = 0;
+
+    writeHuffmanTable(table, shared);
+
+    free(shared);
+    fclose(table);
+}
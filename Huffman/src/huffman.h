@@ -1,20 +1,50 @@
 #ifndef HUFFMAN_H
 #define HUFFMAN_H
 
+#include <cstdio>
+#include <string>
+
 #include "structs.h"
 
+/*
+ * Every huffman table in a compressed file starts with its kind (uint8_t). A full table is followed by the 256 symbols,
+ * every symbol stored as a 256 bit number and its length. A reference is followed by the id (uint64_t) of a shared
+ * table file (batch mode) that is stored next to the compressed file. The shared table file holds a full table (a
+ * canonical table with CANONICAL_TABLES), never a reference or a preset id. A canonical table (CANONICAL_TABLES) is
+ * followed by the 256 symbol lengths compressed with run length encoding:
+ *
+ *      uint16_t    The number of bytes of the encoded lengths
+ *      uint8_t[]   The encoded lengths. A control byte c < 128 is followed by c + 1 lengths. A control byte c >= 128 is
+ *                  followed by one length that is repeated c - 125 times (3 to 130)
+ *
+ * The symbols of a canonical table are recreated from the lengths by createCanonicalSymbols. A preset table
+ * (TABLE_PRESET) is followed by the id (uint8_t) of a table preset built into the binary (see presets.h).
+ */
+#define TABLE_FULL 0                       // The symbols follow the kind
+#define TABLE_REFERENCE 1                  // The id of a shared table follows the kind
+#define TABLE_CANONICAL 2                  // The encoded symbol lengths follow the kind
+#define TABLE_PRESET_ID 3                  // The id of a built in table preset follows the kind
+#define SHARED_TABLE_EXTENSION ".htable"   // The extension of the shared table files
+
+// The maximum size of a huffman table (a full table) and the size of a reference in the compressed files
+#define HUFFMAN_TABLE_SIZE (1 + 256 * (sizeof(uint256_t) + sizeof(uint8_t)))
+#define TABLE_REFERENCE_SIZE (1 + sizeof(uint64_t))
+#define TABLE_PRESET_ID_SIZE (1 + sizeof(uint8_t))
+
 /**
  * Prints the huffman tree
  *
  * @param nodes        The nodes array of the tree
  * @param nodes_index  The index of the last node in the tree
  */
-void printTree(HuffmanNode *nodes, uint16_t nodes_index);
+template <typename CodeWord>
+void printTree(HuffmanNodeT<CodeWord> *nodes, uint16_t nodes_index);
 
 
 /**
- * The main part of the huffman algorithm. This function calculates all the symbols for the characters that exist (have
- * a frequency of more than 1)
+ * The main part of the huffman algorithm. This function calculates the symbols of all the characters (the characters
+ * with a frequency of 0 get the longest symbols). The code lengths are calculated by huffmanCodeLengths in
+ * O(n log n) and the symbols are canonical.
  *
  * @param asciiHuffman  The huffman struct with the character frequencies
  */
@@ -22,13 +52,234 @@ void createHuffmanTree(ASCIIHuffman *asciiHuffman);
 
 
 /**
- * Creates a huffman tree from an array with the huffman symbols. The depth of every symbol is determined from the
- * number of bits is has. The more bits the deeper on the tree
+ * Creates the symbols of a huffman struct with the package-merge algorithm. The symbols are the optimal prefix code
+ * where no symbol is longer than max_length bits. Every character gets a symbol (the characters with a frequency of 0
+ * get the longest ones).
+ *
+ * @param huffman     The huffman struct with the character frequencies
+ * @param max_length  The maximum symbol length in bits (8 to 255)
+ */
+void createLengthLimitedCodes(ASCIIHuffman *huffman, uint8_t max_length);
+
+
+/**
+ * Creates canonical symbols from the symbol lengths. The symbols of the same length are consecutive numbers ordered by
+ * character and every symbol is bigger than the symbols of the shorter lengths, so only the lengths define the table.
+ *
+ * @param huffman  The huffman struct the symbols are stored to
+ * @param lengths  The length of the symbol of every character (256 elements)
+ */
+void createCanonicalSymbols(ASCIIHuffman *huffman, const uint8_t *lengths);
+
+
+/**
+ * Calculates the number of bits needed to encode the characters of a frequency array with the symbols of the huffman
+ * struct
+ *
+ * @param frequency_arr  The frequency array (256 elements)
+ * @param huffman        The huffman struct with the symbols
+ * @return               The number of encoded bits
+ */
+uint64_t encodedBits(const uint64_t *frequency_arr, const ASCIIHuffman *huffman);
+
+
+/**
+ * Calculates the redundancy of a table on a histogram: the bits per character the symbols cost above the entropy of the
+ * histogram (the cross entropy of the histogram against the symbol lengths minus its entropy)
+ *
+ * @param frequency_arr  The histogram (256 elements)
+ * @param huffman        The huffman struct with the symbols
+ * @return               The redundancy in bits per character (0 for an empty histogram)
+ */
+double tableRedundancy(const uint64_t *frequency_arr, const ASCIIHuffman *huffman);
+
+
+/**
+ * Decides if the table of a stream of chunks has to be rebuilt for the histogram of the next chunk (TABLE_REUSE). The
+ * drift is the redundancy of the table on the histogram minus the redundancy it had on the histogram it was built from.
+ * The table is rebuilt when the drift is more than TABLE_DRIFT_THRESHOLD bits per character and the extra bits pay for
+ * storing the new table (table_size bytes).
+ *
+ * @param frequency_arr     The histogram of the next chunk (256 elements)
+ * @param huffman           The huffman struct with the current table
+ * @param built_redundancy  The redundancy of the current table on the histogram it was built from
+ * @param table_size        The size of the new table in the compressed file in bytes
+ * @return                  True if the table has to be rebuilt
+ */
+bool tableDrifted(const uint64_t *frequency_arr, const ASCIIHuffman *huffman, double built_redundancy,
+                  uint32_t table_size);
+
+
+/**
+ * Creates a huffman tree from an array with the huffman symbols. Every symbol is inserted from the root following its
+ * bits (0 left, 1 right) and the missing internal nodes are created on the way, so the tree is built in time linear to
+ * the total length of the symbols. The leaf of character i is tree[i]. The code word of the nodes must fit the longest
+ * symbol (see codeWordWidth). It is instantiated for uint32_t, uint64_t and uint256_t.
  *
  * @param asciiHuffman  The symbols array
  * @param tree          The array that holds all the nodes
  * @return              The index of the top node
  */
-uint16_t huffmanFromArray(ASCIIHuffman *huffman, HuffmanNode *tree);
+template <typename CodeWord>
+uint16_t huffmanFromArray(ASCIIHuffman *huffman, HuffmanNodeT<CodeWord> *tree);
+
+
+/**
+ * Finds the narrowest code word that fits every symbol of a huffman struct
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @return         The width of the code word in bits (32, 64 or 256)
+ */
+uint16_t codeWordWidth(const ASCIIHuffman *huffman);
+
+
+/**
+ * Calls a generic function with a code word of the narrowest type that fits every symbol of a huffman struct (see
+ * codeWordWidth). The function is a lambda with an auto parameter and the type of the code word is the type of its
+ * argument, so the templated code of a table is instantiated once per width and selected at run time.
+ *
+ * @param huffman   The huffman struct with the symbols
+ * @param function  The function called with a code word (uint32_t, uint64_t or uint256_t)
+ */
+template <typename Function>
+inline void dispatchCodeWord(const ASCIIHuffman *huffman, Function function) {
+    // Typical tables never use the uint256_t symbols
+    switch (codeWordWidth(huffman)) {
+        case 32:
+            function(uint32_t());
+            break;
+
+        case 64:
+            function(uint64_t());
+            break;
+
+        default:
+            function(uint256_t());
+    }
+}
+
+
+/**
+ * Copies the symbols of a huffman struct to an array of narrower code words. The code word must fit the longest symbol
+ * (see codeWordWidth). It is instantiated for uint32_t, uint64_t and uint256_t.
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @param symbols  The narrow symbols (256 elements)
+ */
+template <typename CodeWord>
+void narrowSymbols(const ASCIIHuffman *huffman, SymbolT<CodeWord> *symbols);
+
+
+/**
+ * Returns a bit of a code word
+ *
+ * @param code  The code word
+ * @param bit   The index of the bit (0 is the LSB)
+ * @return      The bit
+ */
+template <typename CodeWord>
+inline bool codeBit(CodeWord code, uint8_t bit) {
+    return (code >> bit) & 1;
+}
+
+inline bool codeBit(const uint256_t &code, uint8_t bit) {
+    // The 64 bit word of the bit is selected without the multi word shift of uint256_t
+    const uint128_t &half = bit < 128 ? code.lower() : code.upper();
+    uint64_t word = (bit & 127) < 64 ? half.lower() : half.upper();
+
+    return (word >> (bit & 63)) & 1;
+}
+
+
+
+/**
+ * Writes a huffman table to a file. If the huffman struct has a preset_id only the id of the preset is written and if
+ * it has a table_id only a reference to the shared table is written. Otherwise the symbol lengths are written if
+ * CANONICAL_TABLES is defined (the symbols must be canonical) or the full table (every symbol followed by its length)
+ *
+ * @param file     The file pointer
+ * @param huffman  The huffman struct containing all the symbols
+ * @return         The number of bytes written
+ */
+uint32_t writeHuffmanTable(FILE *file, const ASCIIHuffman *huffman);
+
+
+/**
+ * Reads a huffman table written by writeHuffmanTable. A reference is resolved by reading the shared table file stored
+ * next to the file and a preset id by the built in preset
+ *
+ * @param file      The file pointer
+ * @param huffman   The huffman struct the symbols are stored to
+ * @param filename  The name of the file (used to find the shared tables)
+ * @return          The number of bytes read from the file
+ */
+uint32_t readHuffmanTable(FILE *file, ASCIIHuffman *huffman, const std::string& filename);
+
+
+/**
+ * Calculates the number of bytes writeHuffmanTable writes for a huffman struct
+ *
+ * @param huffman  The huffman struct containing all the symbols
+ * @return         The size of the table in bytes
+ */
+uint32_t huffmanTableSize(const ASCIIHuffman *huffman);
+
+
+/**
+ * Chooses the table of a section (SECTION_TABLES). A table is created from the frequencies of the section and it is
+ * used if the bytes it saves are more than its size (huffmanTableSize), otherwise the section uses the global table.
+ *
+ * @param huffman      The huffman struct with the global table
+ * @param frequencies  The frequencies of the section (256 elements)
+ * @return             The global huffman struct or a new one (free it) with the table of the section
+ */
+ASCIIHuffman *chooseSectionTable(ASCIIHuffman *huffman, const uint64_t *frequencies);
+
+
+/**
+ * Writes the tables of the sections after the global table (SECTION_TABLES). Every section has a flag (uint8_t) that
+ * is 1 if the table of the section follows and 0 if the section uses the global table.
+ *
+ * @param file            The file pointer
+ * @param huffman         The huffman struct with the global table
+ * @param section_tables  The table of every section (chooseSectionTable)
+ * @param n_sections      The number of sections
+ * @return                The number of bytes written
+ */
+uint32_t writeSectionTables(FILE *file, const ASCIIHuffman *huffman, ASCIIHuffman **section_tables, uint8_t n_sections);
+
+
+/**
+ * Reads the tables of the sections written by writeSectionTables
+ *
+ * @param file            The file pointer
+ * @param huffman         The huffman struct with the global table
+ * @param section_tables  The table of every section. A section without a table gets the global huffman struct, the
+ *                        others get a new one (free it)
+ * @param n_sections      The number of sections
+ * @param filename        The name of the file (used to find the shared tables)
+ * @return                The number of bytes read from the file
+ */
+uint32_t readSectionTables(FILE *file, ASCIIHuffman *huffman, ASCIIHuffman **section_tables, uint8_t n_sections,
+                           const std::string& filename);
+
+
+/**
+ * Calculates the id of a table (the hash of its symbols). The id is never 0
+ *
+ * @param huffman  The huffman struct with the symbols
+ * @return         The id of the table
+ */
+uint64_t huffmanTableId(const ASCIIHuffman *huffman);
+
+
+/**
+ * Stores a shared table next to a compressed file. The table file is named after the table id and it is written only
+ * if it does not exist. It holds a full table (a canonical table with CANONICAL_TABLES)
+ *
+ * @param filename  The name of the compressed file
+ * @param huffman   The huffman struct with the symbols and the table_id
+ */
+void storeSharedTable(const std::string& filename, const ASCIIHuffman *huffman);
 
 #endif //HUFFMAN_TREE
@@ -0,0 +1,193 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "lanes.h"
+
+//#define DEBUG_MODE
+
+#ifdef INTERLEAVED_LANES
+
+
+/**
+ * Creates the lanes of an encoder. The buffer of a lane fits a frame of the longest symbol of the table.
+ *
+ * @param encoder  The encoder
+ * @param huffman  The huffman struct with the symbols
+ */
+void openLaneEncoder(LaneEncoder *encoder, const ASCIIHuffman *huffman) {
+    uint64_t max_length = 0;
+
+    for (const Symbol &symbol : huffman->symbols) {
+        max_length = symbol.symbol_length > max_length ? symbol.symbol_length : max_length;
+    }
+
+    // The characters of a frame per lane, rounded up to 128 bit elements
+    uint64_t lane_chars = (LANE_FRAME_SIZE + INTERLEAVED_LANES - 1) / INTERLEAVED_LANES;
+    encoder->lane_words = (lane_chars * max_length + 2 * WORD_BITS - 1) / (2 * WORD_BITS) * 2 + 2;
+
+    encoder->words = (uint64_t *) malloc(INTERLEAVED_LANES * encoder->lane_words * sizeof(uint64_t));
+    encoder->n_chars = 0;
+
+    for (int lane = 0; lane < INTERLEAVED_LANES; ++lane) {
+        attachBitWriter(&encoder->lanes[lane], encoder->words + lane * encoder->lane_words, encoder->lane_words);
+    }
+}
+
+
+/**
+ * Appends the current frame (if it has characters) to the stream and starts a new frame
+ *
+ * @param encoder  The encoder
+ * @param writer   The writer of the stream
+ */
+void writeLaneFrame(LaneEncoder *encoder, BitWriter *writer) {
+    if (encoder->n_chars == 0) {
+        return;
+    }
+
+    // The header
+    putBits(writer, encoder->n_chars, LANE_HEADER_BITS);
+
+    for (BitWriter &lane : encoder->lanes) {
+        putBits(writer, lane.word_index * WORD_BITS + lane.n_bits, LANE_HEADER_BITS);
+    }
+
+    // The bits of the lanes one after the other
+    for (BitWriter &lane : encoder->lanes) {
+        for (uint64_t w = 0; w < lane.word_index; ++w) {
+            putBits(writer, lane.words[w ^ 1], WORD_BITS);
+        }
+
+        if (lane.n_bits > 0) {
+            putBits(writer, lane.accumulator >> (WORD_BITS - lane.n_bits), lane.n_bits);
+        }
+
+        attachBitWriter(&lane, lane.words, encoder->lane_words);
+    }
+
+#ifdef DEBUG_MODE
+    std::cout << "Lane frame of " << encoder->n_chars << " characters" << std::endl;
+#endif
+
+    encoder->n_chars = 0;
+}
+
+
+/**
+ * Appends the last frame to the stream and frees the lanes
+ *
+ * @param encoder  The encoder
+ * @param writer   The writer of the stream
+ */
+void closeLaneEncoder(LaneEncoder *encoder, BitWriter *writer) {
+    writeLaneFrame(encoder, writer);
+
+    free(encoder->words);
+    encoder->words = nullptr;
+}
+
+
+/**
+ * Returns the number of bits of the frame headers of a stream
+ *
+ * @param n_chars  The number of characters of the stream
+ * @return         The number of header bits
+ */
+uint64_t laneHeaderBits(uint64_t n_chars) {
+    uint64_t n_frames = (n_chars + LANE_FRAME_SIZE - 1) / LANE_FRAME_SIZE;
+
+    return n_frames * (INTERLEAVED_LANES + 1) * LANE_HEADER_BITS;
+}
+
+
+/**
+ * Reads the next frame of a stream to a buffer of words
+ *
+ * @param reader    The reader of the stream (at the frame)
+ * @param words     The buffer of the frame (grown if the frame does not fit, word w holds bits 64w to 64w + 63 from the
+ *                  MSB and the word after the last bit is 0)
+ * @param n_words   The size of the buffer in words
+ * @param position  The bit position of every lane in the frame (INTERLEAVED_LANES elements)
+ * @param n_bits    The number of bits left in the stream (the frame is subtracted)
+ * @return          The number of characters of the frame
+ */
+uint32_t readLaneFrame(BitReader *reader, uint64_t **words, uint64_t *n_words, uint64_t *position, uint64_t *n_bits) {
+    // The frame header
+    auto n_chars = (uint32_t) getBits(reader, LANE_HEADER_BITS);
+    uint64_t frame_bits = 0;
+
+    for (int lane = 0; lane < INTERLEAVED_LANES; ++lane) {
+        position[lane] = frame_bits;
+        frame_bits += getBits(reader, LANE_HEADER_BITS);
+    }
+
+    *n_bits -= (INTERLEAVED_LANES + 1) * LANE_HEADER_BITS + frame_bits;
+
+    // The lanes are copied to the frame buffer. The word after the last bit is 0, so the decoders can peek past it
+    if (frame_bits / WORD_BITS + 2 > *n_words) {
+        free(*words);
+        *n_words = frame_bits / WORD_BITS + 2;
+        *words = (uint64_t *) malloc(*n_words * sizeof(uint64_t));
+    }
+
+    uint64_t w = 0;
+
+    for (; w < frame_bits / WORD_BITS; ++w) {
+        (*words)[w] = getBits(reader, WORD_BITS);
+    }
+
+    (*words)[w] = 0;
+    (*words)[w + 1] = 0;
+
+    if (frame_bits % WORD_BITS != 0) {
+        (*words)[w] = getBits(reader, frame_bits % WORD_BITS) << (WORD_BITS - frame_bits % WORD_BITS);
+    }
+
+    return n_chars;
+}
+
+
+#ifdef TABLE_DECODING
+
+/**
+ * Decodes the frames of a stream with a decode table (TABLE_DECODING) and writes the characters to the decompressed
+ * file
+ *
+ * @param table         The decode table
+ * @param reader        The reader of the stream (at the first frame)
+ * @param n_bits        The number of bits of the stream
+ * @param decompressed  The decompressed file
+ */
+void decodeLanesTable(const DecodeTable *table, BitReader *reader, uint64_t n_bits, FILE *decompressed) {
+    auto *char_buffer = (uint8_t *) malloc(LANE_FRAME_SIZE);
+
+    uint64_t *words = nullptr;  // The bits of the current frame
+    uint64_t n_words = 0;       // The size of the frame buffer in words
+
+    while (n_bits > 0) {
+        uint64_t position[INTERLEAVED_LANES];  // The bit position of every lane in the frame
+        uint32_t n_chars = readLaneFrame(reader, &words, &n_words, position, &n_bits);
+
+        // One symbol of every lane per round. Character i of the frame is in lane i % INTERLEAVED_LANES
+        uint32_t i = 0;
+
+        for (; i + INTERLEAVED_LANES <= n_chars; i += INTERLEAVED_LANES) {
+            for (int lane = 0; lane < INTERLEAVED_LANES; ++lane) {
+                char_buffer[i + lane] = decodeTableWords(table, words, &position[lane]);
+            }
+        }
+
+        for (int lane = 0; i < n_chars; ++i, ++lane) {
+            char_buffer[i] = decodeTableWords(table, words, &position[lane]);
+        }
+
+        fwrite(char_buffer, sizeof(char_buffer[0]), n_chars, decompressed);
+    }
+
+    free(words);
+    free(char_buffer);
+}
+
+#endif
+
+#endif
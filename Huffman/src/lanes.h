@@ -0,0 +1,224 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "structs.h"
+#include "bit_writer.h"
+#include "bit_reader.h"
+#include "decode_table.h"
+
+#ifdef INTERLEAVED_LANES
+
+/*
+ * Interleaved lanes (INTERLEAVED_LANES). The characters of a file or section are encoded in frames of LANE_FRAME_SIZE
+ * characters. Character p of a frame is encoded to lane p % INTERLEAVED_LANES and every lane is a separate bit stream.
+ * A frame is appended to the stream of the file or section as:
+ *
+ *      LANE_HEADER_BITS                        The number of characters of the frame
+ *      LANE_HEADER_BITS x INTERLEAVED_LANES    The number of bits of every lane
+ *      The bits of lane 0, lane 1, ...
+ *
+ * The lanes hold the same symbols as a single stream, so a section is longer only by its frame headers
+ * (laneHeaderBits) and its exact number of bits is still known from the frequencies. The decoder keeps the bit
+ * position of every lane and decodes one symbol of every lane per round. The tree walks of the lanes do not depend on
+ * each other, so the cpu overlaps them instead of waiting for every node of a single walk.
+ */
+
+#define LANE_FRAME_SIZE ENCODE_BUFFER_SIZE  // The number of characters of a frame
+#define LANE_HEADER_BITS 32                 // The number of bits of every number of the frame header
+
+
+typedef struct lane_encoder {
+    BitWriter lanes[INTERLEAVED_LANES];  /// The writers of the lanes of the current frame
+    uint64_t *words = nullptr;           /// The buffers of the lanes (lane_words words per lane)
+    uint64_t lane_words = 0;             /// The size of the buffer of a lane in words
+    uint32_t n_chars = 0;                /// The number of characters of the current frame
+} LaneEncoder;
+
+
+/**
+ * Creates the lanes of an encoder. The buffer of a lane fits a frame of the longest symbol of the table.
+ *
+ * @param encoder  The encoder
+ * @param huffman  The huffman struct with the symbols
+ */
+void openLaneEncoder(LaneEncoder *encoder, const ASCIIHuffman *huffman);
+
+
+/**
+ * Appends the current frame (if it has characters) to the stream and starts a new frame
+ *
+ * @param encoder  The encoder
+ * @param writer   The writer of the stream
+ */
+void writeLaneFrame(LaneEncoder *encoder, BitWriter *writer);
+
+
+/**
+ * Appends the last frame to the stream and frees the lanes
+ *
+ * @param encoder  The encoder
+ * @param writer   The writer of the stream
+ */
+void closeLaneEncoder(LaneEncoder *encoder, BitWriter *writer);
+
+
+/**
+ * Returns the number of bits of the frame headers of a stream
+ *
+ * @param n_chars  The number of characters of the stream
+ * @return         The number of header bits
+ */
+uint64_t laneHeaderBits(uint64_t n_chars);
+
+
+/**
+ * Appends the symbols of a buffer of characters to the lanes. The frames do not depend on how the characters are split
+ * to buffers.
+ *
+ * @param encoder  The encoder
+ * @param writer   The writer of the stream (a full frame is appended to it)
+ * @param data     The characters
+ * @param length   The number of characters
+ * @param symbols  The symbols of the characters (256 elements)
+ */
+template <typename CodeWord>
+inline void putLaneBytes(LaneEncoder *encoder, BitWriter *writer, const uint8_t *data, uint64_t length,
+                         const SymbolT<CodeWord> *symbols) {
+    BitWriter *lanes = encoder->lanes;
+
+    for (uint64_t i = 0; i < length;) {
+        // The characters up to the end of the frame
+        uint64_t n = length - i < LANE_FRAME_SIZE - encoder->n_chars ? length - i : LANE_FRAME_SIZE - encoder->n_chars;
+        uint64_t end = i + n;
+
+        // The characters up to the first lane
+        for (uint32_t lane = encoder->n_chars % INTERLEAVED_LANES; i < end && lane != 0; ++i) {
+            putCode(&lanes[lane], symbols[data[i]].symbol, symbols[data[i]].symbol_length);
+            lane = (lane + 1) % INTERLEAVED_LANES;
+        }
+
+        // One character per lane
+        for (; i + INTERLEAVED_LANES <= end; i += INTERLEAVED_LANES) {
+            for (int lane = 0; lane < INTERLEAVED_LANES; ++lane) {
+                putCode(&lanes[lane], symbols[data[i + lane]].symbol, symbols[data[i + lane]].symbol_length);
+            }
+        }
+
+        for (int lane = 0; i < end; ++i, ++lane) {
+            putCode(&lanes[lane], symbols[data[i]].symbol, symbols[data[i]].symbol_length);
+        }
+
+        encoder->n_chars += n;
+
+        if (encoder->n_chars == LANE_FRAME_SIZE) {
+            writeLaneFrame(encoder, writer);
+        }
+    }
+}
+
+
+/**
+ * Decodes the next symbol of a lane by walking the huffman tree
+ *
+ * @param nodes       The huffman tree array
+ * @param root_index  The index of the root node of the tree
+ * @param words       The bits of the frame (word w holds bits 64w to 64w + 63 from the MSB)
+ * @param position    The bit position of the lane (advanced past the symbol)
+ * @return            The character
+ */
+template <typename CodeWord>
+inline uint8_t decodeLaneSymbol(const HuffmanNodeT<CodeWord> *nodes, uint16_t root_index, const uint64_t *words,
+                                uint64_t *position) {
+    uint64_t bit_pos = *position;
+    uint16_t node = root_index;
+
+    do {
+        uint64_t bit = (words[bit_pos / WORD_BITS] >> (WORD_BITS - 1 - bit_pos % WORD_BITS)) & 1;
+
+        node = bit == 0 ? nodes[node].left : nodes[node].right;
+        ++bit_pos;
+    } while (!nodes[node].isLeaf);
+
+    *position = bit_pos;
+
+    return nodes[node].ascii_index;
+}
+
+
+/**
+ * Reads the next frame of a stream to a buffer of words
+ *
+ * @param reader    The reader of the stream (at the frame)
+ * @param words     The buffer of the frame (grown if the frame does not fit, word w holds bits 64w to 64w + 63 from the
+ *                  MSB and the word after the last bit is 0)
+ * @param n_words   The size of the buffer in words
+ * @param position  The bit position of every lane in the frame (INTERLEAVED_LANES elements)
+ * @param n_bits    The number of bits left in the stream (the frame is subtracted)
+ * @return          The number of characters of the frame
+ */
+uint32_t readLaneFrame(BitReader *reader, uint64_t **words, uint64_t *n_words, uint64_t *position, uint64_t *n_bits);
+
+
+/**
+ * Decodes the frames of a stream and writes the characters to the decompressed file
+ *
+ * @param nodes         The huffman tree array
+ * @param root_index    The index of the root node of the tree
+ * @param reader        The reader of the stream (at the first frame)
+ * @param n_bits        The number of bits of the stream
+ * @param decompressed  The decompressed file
+ */
+template <typename CodeWord>
+void decodeLanes(const HuffmanNodeT<CodeWord> *nodes, uint16_t root_index, BitReader *reader, uint64_t n_bits,
+                 FILE *decompressed) {
+    auto *char_buffer = (uint8_t *) malloc(LANE_FRAME_SIZE);
+
+    uint64_t *words = nullptr;  // The bits of the current frame
+    uint64_t n_words = 0;       // The size of the frame buffer in words
+
+    while (n_bits > 0) {
+        uint64_t position[INTERLEAVED_LANES];  // The bit position of every lane in the frame
+        uint32_t n_chars = readLaneFrame(reader, &words, &n_words, position, &n_bits);
+
+        // One symbol of every lane per round. Character i of the frame is in lane i % INTERLEAVED_LANES
+        uint32_t i = 0;
+
+        for (; i + INTERLEAVED_LANES <= n_chars; i += INTERLEAVED_LANES) {
+            for (int lane = 0; lane < INTERLEAVED_LANES; ++lane) {
+                char_buffer[i + lane] = decodeLaneSymbol(nodes, root_index, words, &position[lane]);
+            }
+        }
+
+        for (int lane = 0; i < n_chars; ++i, ++lane) {
+            char_buffer[i] = decodeLaneSymbol(nodes, root_index, words, &position[lane]);
+        }
+
+        fwrite(char_buffer, sizeof(char_buffer[0]), n_chars, decompressed);
+    }
+
+    free(words);
+    free(char_buffer);
+}
+
+
+#ifdef TABLE_DECODING
+
+/**
+ * Decodes the frames of a stream with a decode table (TABLE_DECODING) and writes the characters to the decompressed
+ * file
+ *
+ * @param table         The decode table
+ * @param reader        The reader of the stream (at the first frame)
+ * @param n_bits        The number of bits of the stream
+ * @param decompressed  The decompressed file
+ */
+void decodeLanesTable(const DecodeTable *table, BitReader *reader, uint64_t n_bits, FILE *decompressed);
+
+#endif
+
+#endif
+
+#endif
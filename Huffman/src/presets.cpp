@@ -0,0 +1,187 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "presets.h"
+#include "huffman.h"
+#include "histogram.h"
+#include "file_utils.h"
+
+//#define DEBUG_MODE
+
+
+/**
+ * The built in presets. The lengths are created with "sequential.out --train". A preset must never change once files
+ * were compressed with it: a retrained preset gets a new id.
+ */
+constexpr TablePreset TABLE_PRESETS[] = {
+    {1, "json", {
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 8, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            4, 15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 5, 7, 6, 7,
+            5, 5, 5, 6, 5, 6, 6, 6, 6, 6, 4, 15, 15, 15, 15, 15,
+            15, 11, 10, 15, 10, 9, 9, 10, 15, 9, 15, 15, 15, 15, 8, 9,
+            15, 15, 9, 15, 8, 10, 15, 11, 15, 15, 8, 15, 15, 15, 15, 6,
+            15, 5, 7, 5, 6, 4, 7, 7, 7, 5, 11, 12, 5, 6, 6, 8,
+            6, 8, 6, 5, 5, 6, 6, 9, 15, 7, 15, 8, 15, 8, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 14, 14, 14
+    }},
+    {2, "csv", {
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 6, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            6, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 5, 5, 15,
+            4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 15, 15, 15, 15, 15, 15,
+            15, 8, 8, 8, 8, 8, 15, 15, 8, 15, 15, 15, 10, 8, 15, 15,
+            7, 15, 15, 15, 7, 15, 8, 8, 15, 15, 15, 15, 15, 15, 15, 14,
+            15, 5, 8, 7, 12, 5, 7, 7, 8, 6, 15, 8, 5, 14, 7, 5,
+            13, 14, 5, 5, 6, 7, 7, 15, 15, 7, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15
+    }},
+    {3, "protobuf", {
+            7, 5, 5, 5, 7, 6, 7, 7, 5, 8, 9, 9, 8, 9, 9, 9,
+            5, 9, 9, 9, 8, 9, 9, 9, 8, 8, 5, 8, 8, 8, 8, 8,
+            8, 5, 8, 8, 8, 8, 8, 8, 5, 10, 10, 10, 10, 10, 10, 10,
+            4, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+            6, 8, 8, 8, 8, 8, 10, 10, 9, 10, 10, 10, 10, 8, 10, 10,
+            8, 9, 9, 9, 8, 9, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9,
+            8, 6, 7, 7, 9, 5, 9, 7, 10, 7, 10, 10, 6, 10, 8, 6,
+            10, 10, 6, 10, 7, 10, 7, 10, 10, 7, 10, 10, 10, 10, 10, 10,
+            8, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            8, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            6, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9
+    }}
+};
+
+
+/**
+ * Finds a built in preset by its id
+ *
+ * @param id  The id of the preset
+ * @return    The preset or nullptr if there is no preset with this id
+ */
+const TablePreset *findPresetById(uint8_t id) {
+    for (const TablePreset &preset : TABLE_PRESETS) {
+        if (preset.id == id) {
+            return &preset;
+        }
+    }
+
+    return nullptr;
+}
+
+
+/**
+ * Loads a preset to a huffman struct. The name is either the name of a built in preset (the preset_id is set) or the
+ * name of a stored preset file (the table_id is set, see storeSharedTable). The program exits if neither exists.
+ *
+ * @param name     The name of a built in preset or a preset file
+ * @param huffman  The huffman struct the symbols are stored to
+ */
+void loadPreset(const std::string& name, ASCIIHuffman *huffman) {
+    for (const TablePreset &preset : TABLE_PRESETS) {
+        if (name == preset.name) {
+            createCanonicalSymbols(huffman, preset.lengths);
+
+            huffman->preset_id = preset.id;
+            huffman->table_id = 0;
+
+            return;
+        }
+    }
+
+    FILE *file = fopen(name.c_str(), "rb");
+
+    if (file == nullptr) {
+        std::cout << "The table preset " << name << " is neither a built in preset nor a preset file" << std::endl;
+        exit(-1);
+    }
+
+    readHuffmanTable(file, huffman, name);
+    fclose(file);
+
+    // The compressed files reference the stored preset as a shared table
+    huffman->preset_id = 0;
+    huffman->table_id = huffmanTableId(huffman);
+}
+
+
+/**
+ * Trains the symbol lengths of a preset from the characters of a corpus. The lengths are length limited to
+ * PRESET_MAX_CODE_LENGTH bits.
+ *
+ * @param files    The file names of the corpus
+ * @param n_files  The number of files
+ * @param lengths  The trained symbol lengths (256 elements)
+ */
+void trainPreset(char **files, int n_files, uint8_t *lengths) {
+    auto *huffman = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+
+    for (int i = 0; i < n_files; ++i) {
+        FILE *file = openBinaryFile(files[i], "rb");
+
+        countFileRange(file, 0, fileSize(files[i]), huffman->charFreq);
+        fclose(file);
+    }
+
+    createLengthLimitedCodes(huffman, PRESET_MAX_CODE_LENGTH);
+
+    for (int i = 0; i < 256; ++i) {
+        lengths[i] = huffman->symbols[i].symbol_length;
+    }
+
+    free(huffman);
+}
+
+
+/**
+ * Stores a trained preset to name + PRESET_EXTENSION and prints its initializer for TABLE_PRESETS
+ *
+ * @param name     The name of the preset
+ * @param lengths  The symbol lengths of the preset (256 elements)
+ */
+void storePreset(const std::string& name, const uint8_t *lengths) {
+    auto *huffman = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+
+    createCanonicalSymbols(huffman, lengths);
+
+    FILE *file = openBinaryFile(name + PRESET_EXTENSION, "wb");
+
+    writeHuffmanTable(file, huffman);
+
+    fclose(file);
+    free(huffman);
+
+    // The initializer of the preset. The id is the next free id of TABLE_PRESETS
+    uint8_t next_id = 1;
+
+    for (const TablePreset &preset : TABLE_PRESETS) {
+        next_id = preset.id >= next_id ? preset.id + 1 : next_id;
+    }
+
+    std::cout << "    {" << unsigned(next_id) << ", \"" << name << "\", {";
+
+    for (int i = 0; i < 256; ++i) {
+        std::cout << (i % 16 == 0 ? "\n            " : " ") << unsigned(lengths[i]) << (i < 255 ? "," : "");
+    }
+
+    std::cout << "\n    }}," << std::endl;
+}
@@ -0,0 +1,72 @@
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <cstdio>
+#include <string>
+
+#include "structs.h"
+
+/*
+ * Table presets are huffman tables trained offline from a sample corpus of a kind of data (JSON logs, CSV exports,
+ * protobuf dumps). A preset is only the 256 canonical symbol lengths, so the built in presets are compiled into the
+ * binary (TABLE_PRESETS in presets.cpp). When TABLE_PRESET is defined the compressors use the preset instead of the
+ * table of the file and the compressed files store only the preset id (TABLE_PRESET_ID_SIZE bytes, see huffman.h).
+ *
+ * A preset is trained with "sequential.out --train name corpus_file..." which prints the initializer of the preset for
+ * TABLE_PRESETS and stores the table to name + PRESET_EXTENSION. A stored preset is loaded like a built in one by
+ * passing its file name to TABLE_PRESET. It has no id, so it is referenced as a shared table (TABLE_REFERENCE).
+ *
+ * The corpus can miss characters of the compressed files, so the trained symbols are length limited and no character
+ * costs more than PRESET_MAX_CODE_LENGTH bits.
+ */
+
+#define PRESET_MAX_CODE_LENGTH 15       // The maximum length of a trained symbol in bits
+#define PRESET_EXTENSION ".preset"      // The extension of the stored preset files
+
+
+typedef struct table_preset {
+    uint8_t id;            /// The id stored in the compressed files (never 0, never reused)
+    const char *name;      /// The name the preset is selected with
+    uint8_t lengths[256];  /// The canonical symbol length of every character
+} TablePreset;
+
+
+/**
+ * Finds a built in preset by its id
+ *
+ * @param id  The id of the preset
+ * @return    The preset or nullptr if there is no preset with this id
+ */
+const TablePreset *findPresetById(uint8_t id);
+
+
+/**
+ * Loads a preset to a huffman struct. The name is either the name of a built in preset (the preset_id is set) or the
+ * name of a stored preset file (the table_id is set, see storeSharedTable). The program exits if neither exists.
+ *
+ * @param name     The name of a built in preset or a preset file
+ * @param huffman  The huffman struct the symbols are stored to
+ */
+void loadPreset(const std::string& name, ASCIIHuffman *huffman);
+
+
+/**
+ * Trains the symbol lengths of a preset from the characters of a corpus. The lengths are length limited to
+ * PRESET_MAX_CODE_LENGTH bits.
+ *
+ * @param files    The file names of the corpus
+ * @param n_files  The number of files
+ * @param lengths  The trained symbol lengths (256 elements)
+ */
+void trainPreset(char **files, int n_files, uint8_t *lengths);
+
+
+/**
+ * Stores a trained preset to name + PRESET_EXTENSION and prints its initializer for TABLE_PRESETS
+ *
+ * @param name     The name of the preset
+ * @param lengths  The symbol lengths of the preset (256 elements)
+ */
+void storePreset(const std::string& name, const uint8_t *lengths);
+
+#endif
@@ -0,0 +1,237 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+
+#include "batch_pth.h"
+#include "compress_pth.h"
+#include "decompress_pth.h"
+#include "../huffman.h"
+#include "../file_utils.h"
+#include "../histogram.h"
+#include "../sparse.h"
+#include "../timer.h"
+
+//#define DEBUG_MODE
+
+using namespace std;
+
+
+typedef struct batch_pool {
+    int n_files = 0;                                    /// The number of files
+    char **filenames = nullptr;                         /// The names of the files
+    uint64_t (*frequencies)[N_THREADS][256] = nullptr;  /// The section frequencies of every file
+
+    int next_file = 0;                                  /// The next file to be counted
+    pthread_mutex_t lock;                               /// Protects next_file
+
+} BatchPool;
+
+
+typedef struct batch_args {
+    int t_id = 0;                   /// The id of the thread
+    BatchPool *pool = nullptr;      /// The shared pool
+    uint64_t char_freq[256] = {0};  /// The frequencies of all the files counted by the thread
+
+} BatchArgs;
+
+
+/**
+ * Counts the frequencies of a file in N_THREADS sections. The sections are the ones compressFile uses, so the file can
+ * be compressed without counting it again
+ *
+ * @param filename     The name of the file
+ * @param frequencies  The frequencies of every section
+ */
+void countFileSections(const string& filename, uint64_t (*frequencies)[256]) {
+    FILE *file = openBinaryFile(filename, "rb");
+
+#ifdef SPARSE_FILES
+    // Only the data extents are counted (see calculateFrequency)
+    SparseMap map;
+    readSparseMap(filename, &map);
+
+    uint64_t file_len = map.data_size;
+#else
+    uint64_t file_len = fileSize(filename);
+#endif
+
+    uint64_t bytes_per_section = file_len / N_THREADS;
+
+    for (int i = 0; i < N_THREADS; ++i) {
+        uint64_t start_byte = i * bytes_per_section;
+
+        // The last section gets the remaining bytes
+        uint64_t end_byte = i == N_THREADS - 1 ? file_len : start_byte + bytes_per_section;
+
+#ifdef SPARSE_FILES
+        countSparseRange(file, &map, start_byte, end_byte, frequencies[i]);
+#else
+        countFileRange(file, start_byte, end_byte, frequencies[i]);
+#endif
+    }
+
+#ifdef SPARSE_FILES
+    freeSparseMap(&map);
+#endif
+
+    fclose(file);
+}
+
+
+/**
+ * The thread function of the pool. The thread takes the next file of the list until all the files are counted
+ *
+ * @param args  The arguments of the thread (BatchArgs)
+ * @return nullptr
+ */
+void *batchFrequencyRunnable(void *args) {
+    auto *arguments = (BatchArgs *) args;
+    BatchPool *pool = arguments->pool;
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        int file = pool->next_file++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (file >= pool->n_files) {
+            break;
+        }
+
+#ifdef DEBUG_MODE
+        cout << "Thread: " << arguments->t_id << " counting " << pool->filenames[file] << endl;
+#endif
+
+        countFileSections(pool->filenames[file], pool->frequencies[file]);
+
+        for (auto &section : pool->frequencies[file]) {
+            for (int j = 0; j < 256; ++j) {
+                arguments->char_freq[j] += section[j];
+            }
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+
+/**
+ * Compresses many files against a single shared huffman table (batch mode). See batch_pth.h for the steps.
+ *
+ * @param n_files     The number of files
+ * @param filenames   The names of the files
+ * @param block_size  The size in bits of the data that every write operation writes to the file
+ */
+void compressBatch(int n_files, char **filenames, uint16_t block_size) {
+    Timer timer;
+
+    BatchPool pool;
+    pool.n_files = n_files;
+    pool.filenames = filenames;
+    pool.frequencies = (uint64_t (*)[N_THREADS][256]) calloc(n_files, sizeof(*pool.frequencies));
+    pthread_mutex_init(&pool.lock, nullptr);
+
+    // STEP 1 - Count the frequencies of all the files with the thread pool
+    cout << "Batch mode: " << N_THREADS << " threads calculating frequencies of " << n_files << " files..." << endl;
+
+    startTimer(&timer);
+
+    BatchArgs args[N_THREADS];
+    pthread_t threads[N_THREADS];
+
+    for (int i = 0; i < N_THREADS; ++i) {
+        args[i].t_id = i;
+        args[i].pool = &pool;
+
+        pthread_create(&threads[i], nullptr, batchFrequencyRunnable, &args[i]);
+    }
+
+    for (pthread_t thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+
+    // STEP 2 - Merge the histograms and create the global table
+    auto *global = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+
+    for (BatchArgs &arg : args) {
+        for (int j = 0; j < 256; ++j) {
+            global->charFreq[j] += arg.char_freq[j];
+        }
+    }
+
+    uint64_t input_size = 0;
+    for (uint64_t freq : global->charFreq) {
+        input_size += freq;
+    }
+
+    stopTimer(&timer);
+
+    cout << "Frequency elapsed time: ";
+    displayElapsed(&timer);
+    displayThroughput(&timer, input_size);
+
+    createHuffmanTree(global);
+
+    // The size of the table every file would store without the shared table (taken before the table gets its id)
+    uint32_t table_size = huffmanTableSize(global);
+    global->table_id = huffmanTableId(global);
+
+    // STEP 3 - Compress every file with the global table
+    cout << "Compressing " << n_files << " files with the shared table " << hex << global->table_id << dec << "..."
+         << endl;
+
+    startTimer(&timer);
+
+    auto *huffman = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+    memcpy(huffman->symbols, global->symbols, sizeof(huffman->symbols));
+    huffman->table_id = global->table_id;
+
+    uint64_t compressed_size = 0;
+
+    for (int i = 0; i < n_files; ++i) {
+        string output_file_name = string(filenames[i]) + ".huff";
+
+        memcpy(huffman->frequencies, pool.frequencies[i], sizeof(huffman->frequencies));
+
+        compressFile(filenames[i], output_file_name, huffman, block_size);
+
+        // The shared table is stored once in the directory of the compressed files
+        storeSharedTable(output_file_name, global);
+
+        compressed_size += fileSize(output_file_name);
+    }
+
+    stopTimer(&timer);
+
+    cout << "Compression elapsed time: ";
+    displayElapsed(&timer);
+    displayThroughput(&timer, input_size);
+
+    cout << "Compressed " << input_size << " bytes to " << compressed_size << " bytes (+" << table_size
+         << " bytes shared table), " << (uint64_t) n_files * (table_size - TABLE_REFERENCE_SIZE) << " table bytes saved"
+         << endl;
+
+    // STEP 4 - Decompress and verify every file
+    cout << "Decompressing files..." << endl;
+
+    startTimer(&timer);
+
+    for (int i = 0; i < n_files; ++i) {
+        decompressFile(string(filenames[i]) + ".huff", string(filenames[i]) + ".dec");
+    }
+
+    stopTimer(&timer);
+
+    cout << "\nOverall decompression elapsed time: ";
+    displayElapsed(&timer);
+
+    for (int i = 0; i < n_files; ++i) {
+        verifyFiles(filenames[i], string(filenames[i]) + ".dec");
+    }
+
+    pthread_mutex_destroy(&pool.lock);
+
+    free(huffman);
+    free(global);
+    free(pool.frequencies);
+}
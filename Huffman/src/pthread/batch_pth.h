@@ -0,0 +1,28 @@
+#ifndef BATCH_PTH_H
+#define BATCH_PTH_H
+
+#include <string>
+
+#include "../structs.h"
+
+/**
+ * Compresses many files against a single shared huffman table (batch mode). The steps are the following:
+ *
+ *   Step 1: A pool of N_THREADS threads counts the frequencies of all the files. Every thread takes the next file of the
+ *           list, so small and large files are balanced between the threads.
+ *
+ *   Step 2: The histograms of all the files are merged and one global table is created. The table is stored once in a
+ *           shared table file (id + SHARED_TABLE_EXTENSION) next to the compressed files.
+ *
+ *   Step 3: Every file is compressed with the global table. The compressed files store only a reference to the shared
+ *           table (TABLE_REFERENCE_SIZE bytes) instead of their own copy of the table.
+ *
+ *   Step 4: Every file is decompressed and verified like in the single file mode.
+ *
+ * @param n_files     The number of files
+ * @param filenames   The names of the files
+ * @param block_size  The size in bits of the data that every write operation writes to the file
+ */
+void compressBatch(int n_files, char **filenames, uint16_t block_size);
+
+#endif
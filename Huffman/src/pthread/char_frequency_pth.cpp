@@ -3,6 +3,8 @@
 
 #include "char_frequency_pth.h"
 #include "../file_utils.h"
+#include "../histogram.h"
+#include "../sparse.h"
 
 //#define DEBUG_MODE
 
@@ -14,41 +16,11 @@ typedef struct freq_args {
     uint64_t start_byte = 0;  // inclusive
     uint64_t end_byte = 0;  // exclusive
 
-} FreqArgs;
-
-
-/**
- * Counts the character frequency of every ascii char of the file being compressed.
- *
- * @param file           The file to count the frequencies
- * @param frequency_arr  The frequency array of the characters
- * @param start_byte     The byte (inclusive, measuring from 0) from where to start counting in the file
- * @param end_byte       The byte (exclusive, measuring from 0) to where to stop counting in the file
- */
-void charFrequency(FILE *file, uint64_t *frequency_arr, uint64_t start_byte, uint64_t end_byte) {
-
-    uint8_t c;  // The character read from the file
-
-    fseek(file, (long)start_byte, SEEK_SET);  // Jump to the beginning of the section to count
-
-    uint64_t file_len = end_byte - start_byte;  // The number of bytes to read from the file
-
-    unsigned long int scan_size = file_len;
-
-    /*// Determine the scan_size of the file
-    if (file_len > SCAN_SIZE)
-        scan_size = SCAN_SIZE;
-    else
-        scan_size = file_len;*/
-
-    // Read from the file byte by byte
-    for (uint64_t i = 0; i < scan_size; ++i) {
-        fread(&c, sizeof(c), 1, file);
+#ifdef SPARSE_FILES
+    const SparseMap *sparse_map = nullptr;  // The data extents of the file (start_byte and end_byte are data offsets)
+#endif
 
-        // For every half char read update the frequency
-        frequency_arr[c]++;
-    }
-}
+} FreqArgs;
 
 
 /**
@@ -67,7 +39,11 @@ void *frequencyRunnable(void *args) {
     FILE *file = openBinaryFile(arguments->filename, "rb");
 
     // Count the frequencies of the part of the file assigned
-    charFrequency(file, arguments->freq_arr, arguments->start_byte, arguments->end_byte);
+#ifdef SPARSE_FILES
+    countSparseRange(file, arguments->sparse_map, arguments->start_byte, arguments->end_byte, arguments->freq_arr);
+#else
+    countFileRange(file, arguments->start_byte, arguments->end_byte, arguments->freq_arr);
+#endif
 
     fclose(file);  // close the file
 
@@ -91,6 +67,16 @@ void calculateFrequency(const std::string& filename, ASCIIHuffman *huffman) {
 
     rewind(file);  // Jump back to the beginning of the file
 
+#ifdef SPARSE_FILES
+    // The threads divide the data extents of the file. The holes are not read
+    SparseMap map;
+    readSparseMap(filename, &map);
+
+    std::cout << map.n_extents << " data extents, " << file_len - map.data_size << " bytes in holes skipped" << std::endl;
+
+    file_len = map.data_size;
+#endif
+
     // Initialize the thread attributes
     pthread_attr_t pthread_custom_attr;
     pthread_attr_init(&pthread_custom_attr);
@@ -122,6 +108,9 @@ void calculateFrequency(const std::string& filename, ASCIIHuffman *huffman) {
         thread_args[i].t_id = i;
         thread_args[i].freq_arr = huffman->frequencies[i];
         thread_args[i].filename = filename;
+#ifdef SPARSE_FILES
+        thread_args[i].sparse_map = &map;
+#endif
 
         if (i == N_THREADS - 1) {
             thread_args[i].start_byte = i * b_per_thr;
@@ -164,6 +153,10 @@ void calculateFrequency(const std::string& filename, ASCIIHuffman *huffman) {
     // Delete the attributes
     pthread_attr_destroy(&pthread_custom_attr);
 
+#ifdef SPARSE_FILES
+    freeSparseMap(&map);
+#endif
+
     // Close the file
     fclose(file);
 }
\ No newline at end of file
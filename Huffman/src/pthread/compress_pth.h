@@ -7,29 +7,30 @@
 /**
  * Takes the file to be compressed reads the bits and creates a new compressed file. The compressed file has the
  * following format:
- *      Byte 0         The number of sections in the file (uint8_t)  (In this example 3)
- *      Byte 1:8       The number of characters of the first section (uint64_t)
- *      Byte 9:16      The number of characters of the second section (uint64_t)
- *      Byte 17:24     The number of characters of the third section (uint64_t)
- *      .
- *      .
- *      .
- *      Byte 45:28     The number of the padding bits added to the end of the first section (uint32_t)
- *      Byte 29:32     The number of the padding bits added to the end of the second section (uint32_t)
- *      Byte 33:36     The number of the padding bits added to the end of the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 37:40     The number of blocks in the first section (uint32_t)
- *      Byte 41:44     The number of blocks in the second section (uint32_t)
- *      Byte 45:48     The number of blocks in the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 49:50     The block size used to group data (uint16_t)
- *      Byte 51:8507   The huffman table used to compress the file. After every 256 bit symbol the number of bits used
- *                     by the symbol are written as well as an 8 bit number. The size of the table is 256 x (256 + 8) bits
- *      Byte 8508:end  The compressed data
+ *
+ *      The fields follow each other in this order, n is the number of sections. The tables have a variable size, so the
+ *      offset of the data depends on their kinds:
+ *
+ *      uint8_t        The number of sections n
+ *      uint64_t[n]    The number of characters of every section
+ *      uint32_t[n]    The number of the padding bits added to the end of every section
+ *      uint32_t[n]    The number of blocks of every section
+ *                     (CONTIGUOUS_STREAM) Instead of the padding bits and the blocks, the number of bits of every
+ *                     section (uint64_t[n]). The sections are back to back in one stream padded to a whole block (see
+ *                     stream.h)
+ *      uint8_t[n]     (STORED_SECTIONS) Whether every section is stored
+ *      uint16_t       The block size used to group data
+ *      table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by the
+ *                     symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES), the id of a
+ *                     shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h. There are no
+ *                     tables if every section is stored
+ *      tables         (SECTION_TABLES) For every section a flag (uint8_t) followed by the table of the section if the
+ *                     flag is 1
+ *      data           The compressed data of the sections one after the other
+ *                     (INTERLEAVED_LANES) The data of every section is a sequence of lane frames (see lanes.h)
+ *                     (STORED_SECTIONS) The data of a stored section is its characters padded with 0 bytes to a whole
+ *                     block
+ *      extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  * @param filename             The name of the input file
  * @param compressed_filename  The name of the compressed file
@@ -38,4 +39,18 @@
  */
 void compressFile(const std::string& filename, const std::string& compressed_filename, ASCIIHuffman *huffman, uint16_t block_size);
 
+
+#ifdef FUSED_MODE
+
+/**
+ * Compresses the file in a single pass (fused mode). Every thread counts and encodes a FUSED_CHUNK_SIZE chunk with its
+ * own huffman table. The format of the compressed file is described in fused.h.
+ *
+ * @param filename             The name of the input file
+ * @param compressed_filename  The name of the compressed file
+ */
+void compressFileFused(const std::string& filename, const std::string& compressed_filename);
+
+#endif
+
 #endif
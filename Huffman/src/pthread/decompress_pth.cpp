@@ -1,9 +1,15 @@
 #include <cstring>
 #include <iostream>
+#include <pthread.h>
 
 #include "../structs.h"
 #include "../huffman.h"
 #include "../file_utils.h"
+#include "../fused.h"
+#include "../sparse.h"
+#include "../stream.h"
+#include "../lanes.h"
+#include "../decode_table.h"
 #include "decompress_pth.h"
 
 
@@ -30,7 +36,8 @@ using namespace std;
  * @param c_index        The index of the character buffer
  * @param decompressed   The pointer of the decompressed file
  */
-inline void decodeBuffer(HuffmanNode *nodes, uint16_t root_index, HuffmanNode *node, uint128_t *buffer, uint16_t buffer_start,
+template <typename CodeWord>
+inline void decodeBuffer(HuffmanNodeT<CodeWord> *nodes, uint16_t root_index, HuffmanNodeT<CodeWord> *node, uint128_t *buffer, uint16_t buffer_start,
                          uint16_t buffer_size, uint8_t element_size, uint8_t *char_buffer, uint32_t *c_index,
                          FILE *decompressed){
 
@@ -94,30 +101,90 @@ typedef struct decompress_args{
     uint32_t number_of_padding = 0;        /// The number of padding bits that the thread has to the end of it's section
 
     uint16_t buffer_size = 0;              /// The size of the buffer in bytes
+    bool stored = false;                   /// The characters of the section are stored as they are
 
+#ifdef CONTIGUOUS_STREAM
+    uint32_t first_bit = 0;                /// The first bit of the section in its first element
+    uint64_t n_bits = 0;                   /// The number of bits of the section
+#endif
 } DecompressArgs;
 
 
+#if defined(INTERLEAVED_LANES) || defined(TABLE_DECODING)
 /**
- * The thread function that decompresses the file. Every thread has to decompress a part of the file
- * @param args  The arguments of the thread (DecompressArgs)
- * @return nullptr
+ * Opens the bit reader of the section of a thread
+ *
+ * @param reader           The bit reader
+ * @param input_file       The compressed file (at the start of the section)
+ * @param decompress_args  The arguments of the thread
+ * @return                 The number of symbol bits of the section
  */
-void *decompressFileRunnable(void *args){
-    // Cast the arguments to the correct type
-    auto *decompress_args = (DecompressArgs *) args;
+static uint64_t openSectionReader(BitReader *reader, FILE *input_file, DecompressArgs *decompress_args) {
+#ifdef CONTIGUOUS_STREAM
+    openBitReader(reader, input_file, decompress_args->first_bit);
+
+    return decompress_args->n_bits;
+#else
+    openBitReader(reader, input_file, 0);
+
+    return (uint64_t) decompress_args->number_of_blocks * decompress_args->buffer_size * SYM_BUFF_SIZE -
+           decompress_args->number_of_padding;
+#endif
+}
+#endif
+
+
+#ifdef TABLE_DECODING
+/**
+ * Decompresses the section of a thread with the decode table of its symbols (TABLE_DECODING)
+ *
+ * @param decompress_args  The arguments of the thread
+ * @param input_file       The compressed file (at the start of the section)
+ * @param decompressed     The decompressed file (at the start of the section)
+ */
+void decompressSection(DecompressArgs *decompress_args, FILE *input_file, FILE *decompressed) {
+    BitReader reader;
+    uint64_t n_bits = openSectionReader(&reader, input_file, decompress_args);
+
+    // Every symbol is decoded with a lookup of its first bits
+    DecodeTable table;
+    buildDecodeTable(&table, decompress_args->huffman);
+
+#ifdef INTERLEAVED_LANES
+    decodeLanesTable(&table, &reader, n_bits, decompressed);
+#else
+    decodeTableStream(&table, &reader, n_bits, decompressed);
+#endif
 
+    freeDecodeTable(&table);
+    closeBitReader(&reader);
+}
+
+#else
+
+/**
+ * Decompresses the section of a thread by walking a tree of nodes with a code word type
+ *
+ * @param decompress_args  The arguments of the thread
+ * @param input_file       The compressed file (at the start of the section)
+ * @param decompressed     The decompressed file (at the start of the section)
+ */
+template <typename CodeWord>
+void decompressSectionTree(DecompressArgs *decompress_args, FILE *input_file, FILE *decompressed) {
     // The huffman tree
-    HuffmanNode nodes[511];
+    HuffmanNodeT<CodeWord> nodes[511];
     // Create the nodes of the tree
     uint16_t root_index = huffmanFromArray(decompress_args->huffman, nodes);
 
-    // Open the files
-    FILE *input_file = openBinaryFile(decompress_args->file, "rb");
-    FILE *decompressed = openBinaryFile(decompress_args->output_file, "rb+");
-    // Seek the starting position of the files
-    fseek(input_file, (long int)decompress_args->start_byte, SEEK_SET);
-    fseek(decompressed, (long int)decompress_args->decompressed_start_byte, SEEK_SET);
+#ifdef INTERLEAVED_LANES
+    // The lanes are decoded from the bits of the section
+    BitReader reader;
+    uint64_t n_bits = openSectionReader(&reader, input_file, decompress_args);
+
+    decodeLanes(nodes, root_index, &reader, n_bits, decompressed);
+
+    closeBitReader(&reader);
+#else
 
     /*
      * The buffer holds the data to be written to the input_file. Once the buffer is full the data are written to the input_file
@@ -129,8 +196,43 @@ void *decompressFileRunnable(void *args){
     uint8_t char_buffer[CHAR_BUFF_SIZE];    // The decompressed character
     uint32_t c_index = 0;         // The character buffer index
 
-    HuffmanNode node = nodes[root_index];  // The current node of the tree.
+    HuffmanNodeT<CodeWord> node = nodes[root_index];  // The current node of the tree.
+
+#ifdef CONTIGUOUS_STREAM
+    // The section starts and ends at exact bits of its first and last elements
+    uint64_t end_bit = decompress_args->first_bit + decompress_args->n_bits;
+    uint64_t n_elements = (end_bit + SYM_BUFF_SIZE - 1) / SYM_BUFF_SIZE;
+    uint8_t last_bits = end_bit % SYM_BUFF_SIZE == 0 ? SYM_BUFF_SIZE : end_bit % SYM_BUFF_SIZE;
+
+    for (uint64_t e = 0; e < n_elements; e += decompress_args->buffer_size) {
+        uint16_t n = n_elements - e < decompress_args->buffer_size ? (uint16_t) (n_elements - e)
+                                                                     : decompress_args->buffer_size;
+        uint16_t first = 0;
+        bool last_buffer = e + n == n_elements;
+
+        fread(&buffer[0], sizeof(buffer[0].lower()), n * 2, input_file);
+
+        if (e == 0 && decompress_args->first_bit > 0) {
+            // The bits of the previous section are shifted out of the first element
+            buffer[0] = buffer[0] << decompress_args->first_bit;
+
+            uint8_t useful_bits = (n_elements == 1 ? last_bits : SYM_BUFF_SIZE) - decompress_args->first_bit;
+            decodeBuffer(nodes, root_index, &node, buffer, 0, 1, useful_bits, char_buffer, &c_index, decompressed);
 
+            first = 1;
+        }
+
+        if (first < n) {
+            decodeBuffer(nodes, root_index, &node, buffer, first, last_buffer ? n - 1 : n, SYM_BUFF_SIZE,
+                         char_buffer, &c_index, decompressed);
+        }
+
+        // The last element is followed by the next section or by the padding of the stream
+        if (first < n && last_buffer) {
+            decodeBuffer(nodes, root_index, &node, buffer, n - 1, n, last_bits, char_buffer, &c_index, decompressed);
+        }
+    }
+#else
     // If the input_file has only one block skip to the final block handling
     if (decompress_args->number_of_blocks > 1) {
         // For all the blocks in the input_file except the last one...
@@ -165,13 +267,69 @@ void *decompressFileRunnable(void *args){
     // decode the last element of the buffer
     decodeBuffer(nodes, root_index, &node, buffer, decompress_args->buffer_size - 1, decompress_args->buffer_size, useful_bits,
                  char_buffer, &c_index, decompressed);
+#endif
 
     // Write the remaining chars
     fwrite(char_buffer, sizeof(char_buffer[0]), c_index, decompressed);
 
     free(buffer);
+#endif
+}
+#endif
+
+
+/**
+ * Copies the characters of a stored section of a thread to the decompressed file (STORED_SECTIONS)
+ *
+ * @param decompress_args  The arguments of the thread
+ */
+void copySection(DecompressArgs *decompress_args) {
+    FILE *input_file = openBinaryFile(decompress_args->file, "rb");
+    FILE *decompressed = openBinaryFile(decompress_args->output_file, "rb+");
+
+    copyFileRange(fileno(input_file), decompress_args->start_byte, fileno(decompressed),
+                  decompress_args->decompressed_start_byte,
+                  decompress_args->decompressed_end_byte - decompress_args->decompressed_start_byte);
+
     fclose(input_file);
     fclose(decompressed);
+}
+
+
+/**
+ * The thread function that decompresses the file. Every thread has to decompress a part of the file
+ * @param args  The arguments of the thread (DecompressArgs)
+ * @return nullptr
+ */
+void *decompressFileRunnable(void *args){
+    // Cast the arguments to the correct type
+    auto *decompress_args = (DecompressArgs *) args;
+
+    if (decompress_args->stored) {
+        copySection(decompress_args);
+        pthread_exit(nullptr);
+    }
+
+    // Open the files
+    FILE *input_file = openBinaryFile(decompress_args->file, "rb");
+    FILE *decompressed = openBinaryFile(decompress_args->output_file, "rb+");
+
+    // Seek the starting position of the files
+    fseek(input_file, (long int)decompress_args->start_byte, SEEK_SET);
+    fseek(decompressed, (long int)decompress_args->decompressed_start_byte, SEEK_SET);
+
+    // The decode table is built from the symbols, the tree is walked with the narrowest code word of the symbols
+#ifdef TABLE_DECODING
+    decompressSection(decompress_args, input_file, decompressed);
+#else
+    dispatchCodeWord(decompress_args->huffman, [&](auto code_word) {
+        decompressSectionTree<decltype(code_word)>(decompress_args, input_file, decompressed);
+    });
+#endif
+
+    fclose(input_file);
+    fclose(decompressed);
+
     pthread_exit(nullptr);
 }
 
@@ -180,29 +338,29 @@ void *decompressFileRunnable(void *args){
  *
  *   Step 1: Read the meta data from of the file.
  *
- *      Byte 0         The number of sections in the file (uint8_t)  (In this example 3)
- *      Byte 1:8       The number of decompressed characters of the first section (uint64_t)
- *      Byte 9:16      The number of decompressed characters of the second section (uint64_t)
- *      Byte 17:24     The number of decompressed characters of the third section (uint64_t)
- *      .
- *      .
- *      .
- *      Byte 45:28     The number of the padding bits added to the end of the first section (uint32_t)
- *      Byte 29:32     The number of the padding bits added to the end of the second section (uint32_t)
- *      Byte 33:36     The number of the padding bits added to the end of the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 37:40     The number of blocks in the first section (uint32_t)
- *      Byte 41:44     The number of blocks in the second section (uint32_t)
- *      Byte 45:48     The number of blocks in the third section (uint32_t)
- *      .
- *      .
- *      .
- *      Byte 49:50     The block size used to group data (uint16_t)
- *      Byte 51:8507   The huffman table used to compress the file. After every 256 bit symbol the number of bits used
- *                     by the symbol are written as well as an 8 bit number. The size of the table is 256 x (256 + 8) bits
- *      Byte 8508:end  The compressed data
+ *      The fields follow each other in this order, n is the number of sections. The tables have a variable size, so the
+ *      offset of the data depends on their kinds:
+ *
+ *      uint8_t        The number of sections n
+ *      uint64_t[n]    The number of characters of every section
+ *      uint32_t[n]    The number of the padding bits added to the end of every section
+ *      uint32_t[n]    The number of blocks of every section
+ *                     (CONTIGUOUS_STREAM) Instead of the padding bits and the blocks, the number of bits of every
+ *                     section (uint64_t[n]). The sections are back to back in one stream padded to a whole block (see
+ *                     stream.h)
+ *      uint8_t[n]     (STORED_SECTIONS) Whether every section is stored
+ *      uint16_t       The block size used to group data
+ *      table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by the
+ *                     symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES), the id of a
+ *                     shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h. There are no
+ *                     tables if every section is stored
+ *      tables         (SECTION_TABLES) For every section a flag (uint8_t) followed by the table of the section if the
+ *                     flag is 1
+ *      data           The compressed data of the sections one after the other
+ *                     (INTERLEAVED_LANES) The data of every section is a sequence of lane frames (see lanes.h)
+ *                     (STORED_SECTIONS) The data of a stored section is its characters padded with 0 bytes to a whole
+ *                     block
+ *      extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  *   Step 2: Create the Huffman tree from the huffman table
  *
@@ -225,7 +383,7 @@ void decompressFile(const string& filename, const string& decompressed_filename)
 #ifdef DEBUG_MODE
     cout << "    Reading metadata..." << endl;
 #endif
-    uint16_t  meta_data_size = 0;  // The size of the metadata in bytes
+    uint32_t meta_data_size = 0;  // The size of the metadata in bytes
 
     // STEP 1 - Read the number of sections
     uint8_t n_sections;  // The number of sections is yhe number of threads used to compress the file
@@ -237,31 +395,66 @@ void decompressFile(const string& filename, const string& decompressed_filename)
     fread(section_sizes, sizeof(uint64_t), n_sections, input_file);
     meta_data_size += sizeof(uint64_t) * n_sections;  // increment the meta data size
 
+    auto *section_padding = (uint32_t *) calloc(n_sections, sizeof(uint32_t));
+    auto *n_blocks = (uint32_t *) calloc(n_sections, sizeof(uint32_t));
+
+#ifdef CONTIGUOUS_STREAM
+    // STEP 3 - Read the number of bits of each section and place the sections in the stream
+    auto *sections = (StreamSection *) calloc(n_sections, sizeof(StreamSection));
+
+    for (int i = 0; i < n_sections; ++i) {
+        fread(&sections[i].n_bits, sizeof(sections[i].n_bits), 1, input_file);
+        meta_data_size += sizeof(sections[i].n_bits);  // increment the meta data size
+    }
+
+    placeStreamSections(sections, n_sections);
+#else
     // STEP 3 - Read the number of padding bits of each section
-    auto *section_padding = (uint32_t *) malloc(n_sections * sizeof(uint32_t));
     fread(section_padding, sizeof(uint32_t), n_sections, input_file);
     meta_data_size += sizeof(uint32_t) * n_sections;  // increment the meta data size
 
     // STEP 4 - Read the number of blocks of each section
-    auto *n_blocks = (uint32_t *) malloc(n_sections * sizeof(uint32_t));
     fread(n_blocks, sizeof(uint32_t), n_sections, input_file);
     meta_data_size += sizeof(uint32_t) * n_sections;  // increment the meta data size
+#endif
+
+    auto *stored = (uint8_t *) calloc(n_sections, sizeof(uint8_t));  // 1 if the section is stored
+
+#ifdef STORED_SECTIONS
+    // STEP 4b - Read if each section is stored
+    fread(stored, sizeof(uint8_t), n_sections, input_file);
+    meta_data_size += sizeof(uint8_t) * n_sections;  // increment the meta data size
+#endif
 
     // STEP 5 - Read the block size used to group data to the compressed file.
     uint16_t block_size;
     fread(&block_size, sizeof(block_size), 1, input_file);
     meta_data_size += sizeof(block_size);  // increment the meta data size
 
+    // The file has no tables if every section is stored
+    bool has_tables = false;
+
+    for (int i = 0; i < n_sections; ++i) {
+        has_tables = has_tables || stored[i] == 0;
+    }
+
     // Retrieve the huffman info
     ASCIIHuffman huffman;
 
-    for (Symbol &symbol : huffman.symbols) {
-        // Read all the symbols from the input_file
-        fread(&symbol.symbol, sizeof(huffman.symbols[0].symbol), 1, input_file);
-        meta_data_size += sizeof(huffman.symbols[0].symbol);  // increment the meta data size
+    // The table of every section
+    auto **section_tables = (ASCIIHuffman **) malloc(n_sections * sizeof(ASCIIHuffman *));
+
+    for (int i = 0; i < n_sections; ++i) {
+        section_tables[i] = &huffman;
+    }
+
+    if (has_tables) {
+        meta_data_size += readHuffmanTable(input_file, &huffman, filename);  // increment the meta data size
 
-        fread(&symbol.symbol_length, sizeof(huffman.symbols[0].symbol_length), 1, input_file);
-        meta_data_size += sizeof(huffman.symbols[0].symbol_length);  // increment the meta data size
+#ifdef SECTION_TABLES
+        // STEP 7 - Read the tables of the sections
+        meta_data_size += readSectionTables(input_file, &huffman, section_tables, n_sections, filename);
+#endif
     }
 
     #ifdef DEBUG_MODE
@@ -302,6 +495,16 @@ void decompressFile(const string& filename, const string& decompressed_filename)
         args[i].file = filename.c_str();
         args[i].output_file = decompressed_filename.c_str();
 
+#ifdef CONTIGUOUS_STREAM
+        // The section starts at an exact bit of the stream
+        uint64_t end_element = (sections[i].start_bit + sections[i].n_bits + SYM_BUFF_SIZE - 1) / SYM_BUFF_SIZE;
+
+        args[i].start_byte = meta_data_size + sections[i].start_bit / SYM_BUFF_SIZE * (SYM_BUFF_SIZE / 8);
+        args[i].end_byte = meta_data_size + end_element * (SYM_BUFF_SIZE / 8);
+        args[i].first_bit = sections[i].start_bit % SYM_BUFF_SIZE;
+        args[i].n_bits = sections[i].n_bits;
+        args[i].decompressed_start_byte = i == 0 ? 0 : args[i - 1].decompressed_end_byte;
+#else
         if (i == 0){
             args[i].start_byte = meta_data_size;
             args[i].decompressed_start_byte = 0;
@@ -312,6 +515,7 @@ void decompressFile(const string& filename, const string& decompressed_filename)
 
         // The block size is in bits, so we need to convert it to bytes
         args[i].end_byte = args[i].start_byte + n_blocks[i] * (block_size / 8);
+#endif
         args[i].decompressed_end_byte = args[i].decompressed_start_byte + section_sizes[i];
 
         args[i].number_of_blocks = n_blocks[i];
@@ -319,7 +523,8 @@ void decompressFile(const string& filename, const string& decompressed_filename)
 
         args[i].buffer_size = block_size / SYM_BUFF_SIZE;
 
-        args[i].huffman = &huffman;
+        args[i].huffman = section_tables[i];
+        args[i].stored = stored[i] == 1;
     }
 
     // Create the threads
@@ -340,14 +545,14 @@ void decompressFile(const string& filename, const string& decompressed_filename)
         }
     #endif
 
-    // Create the threads
-    for (int i = 0; i < N_THREADS; i++) {
+    // Create the threads (one per section of the file, whatever N_THREADS was when it was compressed)
+    for (int i = 0; i < n_sections; i++) {
         args[i].t_id = i;
         pthread_create(&threads[i], &attributes, decompressFileRunnable, &args[i]);
     }
 
     // Join the threads
-    for (int i = 0; i < N_THREADS; i++) {
+    for (int i = 0; i < n_sections; i++) {
         pthread_join(threads[i], nullptr);
     }
 
@@ -358,4 +563,83 @@ void decompressFile(const string& filename, const string& decompressed_filename)
     free(section_sizes);
     free(section_padding);
     free(n_blocks);
-}
\ No newline at end of file
+    free(stored);
+
+#ifdef CONTIGUOUS_STREAM
+    free(sections);
+#endif
+
+    for (int i = 0; i < n_sections; ++i) {
+        if (section_tables[i] != &huffman) {
+            free(section_tables[i]);
+        }
+    }
+
+    free(section_tables);
+
+#ifdef SPARSE_FILES
+    // The decompressed file contains only the data extents. Move them to their offsets and recreate the holes
+    restoreSparseFile(filename, decompressed_filename);
+#endif
+}
+
+
+#ifdef FUSED_MODE
+
+/**
+ * The thread function of fused mode. The thread decodes one chunk of the batch
+ *
+ * @param args  The chunk to decode (FusedChunk)
+ * @return nullptr
+ */
+void *decompressChunkRunnable(void *args) {
+    decodeFusedChunk((FusedChunk *) args);
+
+    pthread_exit(nullptr);
+}
+
+
+/**
+ * Decompresses a file compressed in fused mode. The main thread reads a batch of N_THREADS chunks, the threads decode
+ * them and the main thread writes the decoded chunks in order.
+ *
+ * @param filename               The name of the file to be decompressed
+ * @param decompressed_filename  The name of the decompressed file
+ */
+void decompressFileFused(const string& filename, const string& decompressed_filename) {
+    FILE *file = openBinaryFile(filename, "rb");
+    FILE *decompressed = openBinaryFile(decompressed_filename, "wb");
+
+    uint64_t n_chunks = readFusedHeader(file);
+
+    FusedChunk chunks[N_THREADS];
+    pthread_t threads[N_THREADS];
+
+    for (FusedChunk &chunk : chunks) {
+        initFusedChunk(&chunk);
+    }
+
+    for (uint64_t first = 0; first < n_chunks; first += N_THREADS) {
+        int batch = n_chunks - first < N_THREADS ? (int) (n_chunks - first) : N_THREADS;
+
+        for (int i = 0; i < batch; ++i) {
+            // A chunk without a table uses the table of the chunk before it (the last chunk of the previous batch)
+            readFusedChunk(file, &chunks[i], &chunks[i == 0 ? N_THREADS - 1 : i - 1]);
+            pthread_create(&threads[i], nullptr, decompressChunkRunnable, &chunks[i]);
+        }
+
+        for (int i = 0; i < batch; ++i) {
+            pthread_join(threads[i], nullptr);
+            fwrite(chunks[i].data, sizeof(chunks[i].data[0]), chunks[i].n_chars, decompressed);
+        }
+    }
+
+    for (FusedChunk &chunk : chunks) {
+        freeFusedChunk(&chunk);
+    }
+
+    fclose(decompressed);
+    fclose(file);
+}
+
+#endif
@@ -4,9 +4,14 @@
 #include "../structs.h"
 #include "../huffman.h"
 #include "../file_utils.h"
+#include "../freq_cache.h"
+#include "../histogram.h"
+#include "../presets.h"
+#include "../bit_writer.h"
 #include "char_frequency_pth.h"
 #include "compress_pth.h"
 #include "decompress_pth.h"
+#include "batch_pth.h"
 
 //#define DEBUG_MODE
 
@@ -22,12 +27,21 @@ int main(int argc, char **argv) {
     Timer overall_timer;
     Timer all;
 
-    if (argc != 2) {
+    if (argc < 2) {
         cout << "Wrong number of arguments. Expected 1 got " << argc - 1 << endl;
-        cout << "To run this executable run sequential.out path/to/data/file" << endl;
+        cout << "To run this executable run " << argv[0] << " path/to/data/file" << endl;
+        cout << "To compress many files with a shared table run " << argv[0] << " path/to/file1 path/to/file2 ..."
+             << endl;
         return -1;
     }
 
+    // Batch mode. All the files are compressed with one shared table. The files are usually small so smaller blocks
+    // are used to limit the padding of every section
+    if (argc > 2) {
+        compressBatch(argc - 1, argv + 1, 1024);
+        return 0;
+    }
+
     string input_file_name = argv[1];
     string output_file_name = input_file_name + ".huff";
     string decompressed_file_name = input_file_name + ".dec";
@@ -48,18 +62,52 @@ int main(int argc, char **argv) {
     startTimer(&overall_timer);
     startTimer(&all);
 
+#ifdef FUSED_MODE
+    // The frequencies, the table and the compressed data of every chunk are created in a single pass
+    cout << "Compressing file in fused mode (" << FUSED_CHUNK_SIZE << " byte chunks)..." << endl;
+
+    startTimer(&timer);
+
+    compressFileFused(input_file_name, output_file_name);
+
+    stopTimer(&timer);
+
+    cout << "Compression elapsed time: ";
+    displayElapsed(&timer);
+    displayThroughput(&timer, fileSize(input_file_name));
+#else
     cout << "Calculating frequencies..." << endl;
 
     startTimer(&timer);
 
     // Calculate the frequency of the characters
+#ifdef FREQUENCY_CACHE
+    // Skip the frequency pass if the frequencies of the file are cached
+    if (loadFrequencyCache(input_file_name, &huffman, N_THREADS, true)) {
+        cout << "Frequencies loaded from " << input_file_name << FREQ_CACHE_EXTENSION << endl;
+
+    } else {
+        calculateFrequency(input_file_name, &huffman);
+
+        storeFrequencyCache(input_file_name, &huffman, N_THREADS, true);
+    }
+#else
     calculateFrequency(input_file_name, &huffman);
+#endif
 
     stopTimer(&timer);
 
     cout << "Frequency elapsed time: ";
     displayElapsed(&timer);
 
+    // The size of the input file is the sum of all the frequencies
+    uint64_t input_size = 0;
+    for (uint64_t freq : huffman.charFreq) {
+        input_size += freq;
+    }
+
+    displayThroughput(&timer, input_size);
+
     #ifdef DEBUG_MODE
         cout << "Characters frequency: " << endl;
 
@@ -71,11 +119,20 @@ int main(int argc, char **argv) {
         cout << huffman.charFreq[255] << endl;
     #endif
 
+#ifdef TABLE_PRESET
+    // The frequencies only place the sections in the file, the symbols of the preset are used
+    cout << "Loading the table preset " << TABLE_PRESET << "..." << endl;
+
+    startTimer(&timer);
+
+    loadPreset(TABLE_PRESET, &huffman);
+#else
     cout << "Calculating symbols..." << endl;
 
     startTimer(&timer);
 
     createHuffmanTree(&huffman);
+#endif
 
     stopTimer(&timer);
 
@@ -91,16 +148,24 @@ int main(int argc, char **argv) {
         }
     #endif
 
-    cout << "Compressing file..." << endl;
+    cout << "Compressing file (" << encodeKernelName() << " kernel)..." << endl;
 
     startTimer(&timer);
 
     compressFile(input_file_name, output_file_name, &huffman, 8192 * 4);
 
+    // A stored preset is referenced as a shared table
+    if (huffman.table_id != 0) {
+        storeSharedTable(output_file_name, &huffman);
+    }
+
     stopTimer(&timer);
 
     cout << "Compression elapsed time: ";
     displayElapsed(&timer);
+    displayThroughput(&timer, fileSize(input_file_name));
+
+#endif
 
     stopTimer(&overall_timer);
 
@@ -111,7 +176,11 @@ int main(int argc, char **argv) {
 
     startTimer(&timer);
 
+#ifdef FUSED_MODE
+    decompressFileFused(output_file_name, decompressed_file_name);
+#else
     decompressFile(output_file_name, decompressed_file_name);
+#endif
 
     stopTimer(&timer);
 
@@ -1,19 +1,142 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
 #include "char_frequency.h"
+#include "../huffman.h"
 #include "../file_utils.h"
+#include "../histogram.h"
+#include "../sparse.h"
 
-#define SCAN_SIZE (1 * 1024 * 1024 * 1024)  // 1GB
 //#define DEBUG_MODE
 
 
+#ifdef SAMPLE_FREQUENCIES
+
+/**
+ * Estimates the average number of bits per character of the huffman code built from a frequency array
+ *
+ * @param frequency_arr  The frequency array (256 elements)
+ * @return               The estimated bits per character
+ */
+static double estimateBitsPerByte(const uint64_t *frequency_arr) {
+    // A temporary huffman struct is used so the real one is not touched
+    auto *estimate = (ASCIIHuffman *) calloc(1, sizeof(ASCIIHuffman));
+
+    uint64_t n_bytes = 0;
+
+    for (int i = 0; i < 256; ++i) {
+        estimate->charFreq[i] = frequency_arr[i];
+        n_bytes += frequency_arr[i];
+    }
+
+    createHuffmanTree(estimate);
+
+    double bits_per_byte = (double) encodedBits(frequency_arr, estimate) / (double) n_bytes;
+
+    free(estimate);
+
+    return bits_per_byte;
+}
+
+
+/**
+ * Estimates the character frequencies of the file from strided chunks. The first round reads SAMPLE_FIRST_CHUNKS
+ * chunks spread evenly over the whole file. Every next round doubles the number of chunks by reading the chunks in the
+ * middle of the already sampled ones, so the sample always covers the whole file and not only its beginning.
+ *
+ * After every round the huffman code of the sample is built and its cost (bits per byte) is compared with the cost of
+ * the previous round. Once the relative change is less than SAMPLE_TOLERANCE the sample is scaled to the size of the
+ * file. If the sample would grow past half the file the rest of the file is counted as well.
+ *
+ * @param file      The file to sample
+ * @param file_len  The size of the file
+ * @param huffman   The huffman struct
+ */
+void sampleFrequency(FILE *file, uint64_t file_len, ASCIIHuffman *huffman) {
+    uint64_t sample[256] = {0};  // The frequencies of the sampled chunks
+    uint64_t sampled_bytes = 0;  // The number of bytes sampled
+
+    auto *buffer = (uint8_t *) malloc(SAMPLE_CHUNK_SIZE);
+
+    double previous_cost = 0;  // The estimated bits per byte of the previous round
+
+    // In every round the file is divided in n_chunks slots. The first round samples all the slots and every next
+    // round only samples the odd slots because the even ones are the slots of the previous round
+    for (uint64_t n_chunks = SAMPLE_FIRST_CHUNKS; ; n_chunks *= 2) {
+
+        // The sample would cover too much of the file. Count the whole file instead
+        if (n_chunks * SAMPLE_CHUNK_SIZE > file_len / 2) {
+            for (uint64_t &freq : huffman->charFreq) {
+                freq = 0;
+            }
+
+            countFileRange(file, 0, file_len, huffman->charFreq);
+
+            free(buffer);
+            return;
+        }
+
+        uint64_t first = n_chunks == SAMPLE_FIRST_CHUNKS ? 0 : 1;
+        uint64_t step = n_chunks == SAMPLE_FIRST_CHUNKS ? 1 : 2;
+
+        for (uint64_t k = first; k < n_chunks; k += step) {
+            // The start of the slot in the file
+            uint64_t offset = k * (file_len / n_chunks);
+
+            fseek(file, (long) offset, SEEK_SET);
+            size_t n_read = fread(buffer, sizeof(buffer[0]), SAMPLE_CHUNK_SIZE, file);
+
+            countBytes(buffer, n_read, sample);
+            sampled_bytes += n_read;
+        }
+
+        double cost = estimateBitsPerByte(sample);
+
+#ifdef DEBUG_MODE
+        std::cout << "    Sampled " << sampled_bytes << " bytes in " << n_chunks << " chunks, cost: " << cost
+                  << " bits per byte" << std::endl;
+#endif
+
+        if (previous_cost != 0 && (cost - previous_cost) / previous_cost < SAMPLE_TOLERANCE &&
+            (previous_cost - cost) / previous_cost < SAMPLE_TOLERANCE) {
+            break;
+        }
+
+        previous_cost = cost;
+    }
+
+    free(buffer);
+
+    std::cout << "Sampled " << sampled_bytes << " of " << file_len << " bytes" << std::endl;
+
+    // Scale the sample to the size of the file. The rounding error is given to the most frequent character so the sum
+    // of the frequencies is the size of the file
+    uint64_t scaled_sum = 0;
+    int most_frequent = 0;
+
+    for (int i = 0; i < 256; ++i) {
+        huffman->charFreq[i] = (uint64_t) ((double) sample[i] / (double) sampled_bytes * (double) file_len);
+        scaled_sum += huffman->charFreq[i];
+
+        if (sample[i] > sample[most_frequent]) {
+            most_frequent = i;
+        }
+    }
+
+    huffman->charFreq[most_frequent] += file_len - scaled_sum;
+}
+
+#endif
+
+
 /**
- * Counts the character frequency of every ascii char of the file being compressed. The ascii characters are 8 bits long
- * This produces potentially long symbols that are hard to manage. For this reason every char is split in two 4 bit parts
- * This produces 16 different chars and a maximum length of huffman symbols of 15.
+ * Counts the character frequency of every ascii char of the file being compressed.
  *
- * Since the number of different characters is low the huffman tree can be calculated for all the characters even if they
- * are not present. This allows to measure the frequency of the characters on a small part of the file and assume the
- * file is relatively consistent. The larger the area of the file accounted the more accurate the results but the longer
- * it takes to measure
+ * Since the huffman tree is calculated for all the characters even if they are not present, the frequencies can be
+ * measured on a part of the file assuming the file is relatively consistent. When SAMPLE_FREQUENCIES is defined the
+ * frequencies are estimated from strided chunks of the file (see sampleFrequency), otherwise the whole file is counted.
+ * When SPARSE_FILES is defined only the data extents are counted and the holes of the file are never read.
  *
  * @param file     The file to count the frequencies
  * @param huffman  The huffman struct
@@ -21,26 +144,28 @@
 void charFrequency(const std::string& filename, ASCIIHuffman *huffman) {
     FILE *file = openBinaryFile(filename, "rb");
 
-    uint8_t c;  // The character read from the file
-
     fseek(file, 0, SEEK_END);  // Jump to the end of the file
     unsigned long int file_len = ftell(file);  // Get the current byte offset in the file
 
     rewind(file);  // Jump back to the beginning of the file
 
-    uint64_t scan_size = file_len;
+#if defined(SPARSE_FILES)
+    // Count only the data extents. The holes are not encoded so they are not part of the histogram
+    SparseMap map;
+    readSparseMap(filename, &map);
 
-/*    // Determine the scan_size of the file
-    if (file_len > SCAN_SIZE)
-        scan_size = SCAN_SIZE;
-    else
-        scan_size = file_len;*/
+    std::cout << map.n_extents << " data extents, " << file_len - map.data_size << " bytes in holes skipped" << std::endl;
 
-    // Read from the file byte by byte
-    for (unsigned long int i = 0; i < scan_size; ++i) {
-        fread(&c, sizeof(c), 1, file);
+    countSparseRange(file, &map, 0, map.data_size, huffman->charFreq);
 
-        // For every half char read update the frequency
-        huffman->charFreq[c]++;
-    }
-}
\ No newline at end of file
+    freeSparseMap(&map);
+#elif defined(SAMPLE_FREQUENCIES)
+    // Estimate the frequencies from a sample of the file
+    sampleFrequency(file, file_len, huffman);
+#else
+    // Count the bytes of the file in large blocks
+    countFileRange(file, 0, file_len, huffman->charFreq);
+#endif
+
+    fclose(file);
+}
@@ -1,100 +1,56 @@
 #include <cstring>
+#include <iostream>
 #include "compress.h"
 #include "../file_utils.h"
+#include "../huffman.h"
+#include "../fused.h"
+#include "../sparse.h"
+#include "../bit_writer.h"
+#include "../lanes.h"
+#include "../stream.h"
 
 #define CHAR_BUFF_SIZE 2048  // The size of the write buffer
-#define SYM_BUFF_SIZE 128   // The size of the read buffer single element
 
 //#define DEBUG_MODE
 
 
 /**
- * A symbol is inserted in the buffer. If the buffer is full after the insertion the buffer is written to the compressed
- * file.
- *
- * @param buffer         The buffer that is written to the file. The buffer is 128 x n array
- * @param buff_index     The index to the buffer
- * @param write_index    The index of the bit for the 128 bit buffer element
- * @param compressed     The file compressed pointer
- * @param symbol_length  The length of the symbol to insert to the buffer
- * @param symbol         The symbol to be inserted in the buffer
- * @param bufferSize     The size of the buffer
- */
-void insertToBuffer(uint128_t *buffer, int *buff_index, uint8_t *write_index, uint32_t *nBlocks, FILE *compressed,
-                    uint8_t symbol_length, uint256_t symbol, uint16_t bufferSize) {
-
-    buffer[*buff_index] = buffer[*buff_index] << symbol_length;  // make room for the new symbol
-
-    // Keep only the 128 LSBs of the symbol and append it to the buffer
-    buffer[*buff_index] += symbol.lower();
-
-    if (*write_index + 1 - symbol_length == 0) {  // if the symbol fits exactly...
-        *write_index = SYM_BUFF_SIZE - 1;  // ... reset the write_index ...
-        *buff_index += 1;  // ... and increment the buffer index
-
-        // If the buffer is full...
-        if (*buff_index == bufferSize){
-            //... write the buffer to the file...
-            fwrite(buffer, sizeof(buffer[0]), bufferSize, compressed);
-
-            *nBlocks += 1;  // increment the number of blocks
-            *buff_index = 0;  // ... and reset the index
-
-            // reset the buffer
-            for (int i = 0; i < bufferSize; ++i) {
-                buffer[i] = 0;
-            }
-        }
-
-    } else {  // else if there is still space in the symbol
-        *write_index -= symbol_length;  // Update the write index
-    }
-}
-
-
-/**
- * The worst case regarding symbol length is 32 bytes. This is a rare and very specific case. To conserve as much
- * space as possible we store the symbols using the minimum number of bytes required. After every symbol the length
- * of it is written. Before the huffman table the number of bytes per symbols is also written in the file
- *
- * @param file     The compressed file pointer
- * @param huffman  The huffman struct containing all the symbols
- */
-void writeHuffmanToFile(FILE *file, ASCIIHuffman *huffman) {
-
-    // Write the symbols with their lengths in the file
-    for (Symbol &symbol : huffman->symbols) {
-        // Write the huffman table to the beginning of the file
-        fwrite(&symbol.symbol, sizeof(huffman->symbols[0].symbol), 1, file);
-
-        // Write the length of the symbol to the file
-        fwrite(&symbol.symbol_length, sizeof(symbol.symbol_length), 1, file);
-    }
-}
-
-
-/**
- * Takes the file to be compressed reads the bits and creates a new compressed file. The compressed file has the
- * following format:
- *
- *      Byte 0:3       The number of the padding bits added to the end of the file (uint32_t)
- *      Byte 4:7       The number of blocks in the file (uint32_t)
- *      Byte 8:9       The block size used to group data (uint16_t)
- *      Byte 10:8457   The huffman table used to compress the file. After every 256 bit symbol the number of bits used
- *                     by the symbol are written as well as an 8 bit number. The size of the table is 256 x (256 + 8) bits
- *      Byte 8457:end  The compressed data
+ * Compresses the file with the symbols narrowed to a code word type (see compressFile for the format)
  *
  * @param filename         The name of the file to be compressed
  * @param output_filename  The name of the compressed file
  * @param huffman          The huffman struct that contains the information for the compression
  * @param blockSize        The size in bytes of the data that every write operation writes to the file. (must be power of 2)
  */
-void compressFile(const std::string& filename, const std::string& output_filename, ASCIIHuffman *huffman, uint16_t blockSize) {
+template <typename CodeWord>
+void compressFileWidth(const std::string& filename, const std::string& output_filename, ASCIIHuffman *huffman, uint16_t blockSize) {
 
     // Create the new file
     FILE *compressed = openBinaryFile(output_filename, "wb");
     FILE *file = openBinaryFile(filename, "rb");
 
+    fseek(file, 0, SEEK_END);  // Jump to the end of the file
+    long unsigned int file_len = ftell(file);  // Get the current byte offset in the file
+
+    rewind(file);  // Jump back to the beginning of the file
+
+#ifdef SPARSE_FILES
+    // Only the data extents are compressed. The file is seeked to the next extent when the current one ends
+    SparseMap map;
+    readSparseMap(filename, &map);
+
+    file_len = map.data_size;
+    uint64_t extent_end = seekData(file, &map, 0);
+#endif
+
+    bool stored = false;  // The characters are copied as they are instead of encoded
+
+#ifdef STORED_SECTIONS
+    // The file is stored if its symbols and its table would not make it smaller (estimated with sampled frequencies)
+    stored = storedStream(huffman->charFreq, huffman, 8 * (uint64_t) huffmanTableSize(huffman));
+#endif
+
+#ifdef PATCH_HEADER
     // This is the number of padding bits to the end of the file. The padding bits align the data to bytes.
     uint32_t nPaddingBits = 0;
 
@@ -107,91 +63,126 @@ void compressFile(const std::string& filename, const std::string& output_filenam
 
     // Write the number of blocks. The actual number will be written in the end of the process
     fwrite(&nBlocks, sizeof(nBlocks), 1, compressed);
+#else
+    // The exact number of bits of the stream gives the number of padding bits and blocks before the data is written
+    uint64_t n_bits = stored ? 8 * (uint64_t) file_len : streamBits(huffman->charFreq, huffman);
 
-    // Write the block size used to group data to the compressed file.
-    fwrite(&blockSize, sizeof(blockSize), 1, compressed);
+    uint32_t nPaddingBits = streamPadding(n_bits, blockSize);
+    auto nBlocks = (uint32_t) streamBlocks(n_bits, blockSize);
 
-    // Write the huffman table to the beginning of the file
-    writeHuffmanToFile(compressed, huffman);
+    fwrite(&nPaddingBits, sizeof(nPaddingBits), 1, compressed);
+    fwrite(&nBlocks, sizeof(nBlocks), 1, compressed);
+#endif
 
-    uint16_t bufferSize = blockSize / SYM_BUFF_SIZE;
+    // Write the block size used to group data to the compressed file.
+    fwrite(&blockSize, sizeof(blockSize), 1, compressed);
 
-    // The buffer holds the data to be written to the file. Once the buffer is full the data are written to the file
-    // and the buffer is overwritten with the next part of data. The process repeats until the end
-    auto *buffer = (uint128_t *) calloc(bufferSize, sizeof(uint128_t));
+#ifdef STORED_SECTIONS
+    // Write if the file is stored
+    auto stored_flag = (uint8_t) (stored ? 1 : 0);
+    fwrite(&stored_flag, sizeof(stored_flag), 1, compressed);
+#endif
 
-    // Start reading from the file and converting chars to symbols
-    uint8_t c;  // The character read from the file
+    // Write the huffman table to the beginning of the file (a stored file has no table)
+    if (!stored) {
+        writeHuffmanTable(compressed, huffman);
+    }
 
-    fseek(file, 0, SEEK_END);  // Jump to the end of the file
-    long unsigned int file_len = ftell(file);  // Get the current byte offset in the file
+    // The symbols are appended to the blocks of the compressed file by the bit writer
+    BitWriter writer;
 
-    rewind(file);  // Jump back to the beginning of the file
+    if (!stored) {
+        openBitWriter(&writer, compressed, blockSize);
+    }
 
-    uint256_t symbol = 0;  // The symbol along with the symbol length of every char
-    uint8_t symbol_length = 0;  // The symbol length
-    uint8_t write_index = SYM_BUFF_SIZE - 1;  // The index of the start point of the symbol in the buffer
+    // The symbols with the narrowest code word that fits the longest symbol
+    SymbolT<CodeWord> symbols[256];
+    narrowSymbols(huffman, symbols);
 
-    // The index to the buffer
-    int buff_index = 0;
+    uint32_t *pair_codes = nullptr;
 
-    // Read from the file byte by byte
-    for (long unsigned int i = 0; i < file_len; ++i) {
-        fread(&c, sizeof(c), 1, file);  // Read from the file
+#ifdef PAIR_ENCODING
+    // Two characters are encoded with one lookup whenever their symbols fit a pair code
+    pair_codes = (uint32_t *) malloc(PAIR_CODES_SIZE * sizeof(uint32_t));
+    buildPairCodes(huffman, pair_codes);
+#endif
 
-        symbol = huffman->symbols[c].symbol;  // The symbol of the read char
-        symbol_length = huffman->symbols[c].symbol_length;  // The number of bits of the symbol
+#ifndef INTERLEAVED_LANES
+    // The vector kernel encodes the buffers when every symbol fits VECTOR_CODE_MAX_LENGTH bits
+    uint32_t packed_codes[256];
+    const uint32_t *vector_codes = buildVectorCodes(huffman, packed_codes) ? packed_codes : nullptr;
+#endif
 
-        if (write_index + 1 - symbol_length < 0) {  // If the buffer can't fit the symbol
-            // The buffer can fit write_index + 1 bits of the symbol
+#ifdef INTERLEAVED_LANES
+    // The characters are dealt to the lanes and every full frame is appended to the stream
+    LaneEncoder lanes;
+    openLaneEncoder(&lanes, huffman);
+#endif
 
-            uint256_t mask = (1 << (symbol_length - write_index - 1)) - 1;
+    // Read the file in buffers of ENCODE_BUFFER_SIZE characters and convert the characters to symbols
+    auto *data = (uint8_t *) malloc(ENCODE_BUFFER_SIZE);
 
-            // Split the symbol
-            uint256_t remaining_symbol = symbol & mask;  // keep the remaining symbol
-            uint8_t remaining_length = symbol_length - write_index - 1;
+    for (uint64_t i = 0; i < file_len;) {
+        uint64_t length = file_len - i < ENCODE_BUFFER_SIZE ? file_len - i : ENCODE_BUFFER_SIZE;
 
-            symbol = symbol & ~mask;  // The part of the symbol that fits
-            symbol = symbol >> remaining_length;  // realign the symbol
-            symbol_length = write_index + 1;  // The length of the symbol that fits
+#ifdef SPARSE_FILES
+        // A buffer never crosses the end of an extent
+        if (i == extent_end) {
+            extent_end = seekData(file, &map, i);
+        }
 
-            // append the symbol to the buffer and if the buffer is full write to the file
-            insertToBuffer(buffer, &buff_index, &write_index, &nBlocks, compressed, symbol_length, symbol, bufferSize);
+        length = extent_end - i < length ? extent_end - i : length;
+#endif
+        length = fread(data, sizeof(data[0]), length, file);
 
-            // append the remaining symbol to the buffer and if the buffer is full write to the file
-            insertToBuffer(buffer, &buff_index, &write_index, &nBlocks, compressed, remaining_length, remaining_symbol,
-                           bufferSize);
+        if (length == 0) {
+            std::cout << "Could not read " << filename << std::endl;
+            exit(-1);
+        }
 
-        } else {  // else if the symbol fits in the buffer
+        if (stored) {
+            fwrite(data, sizeof(data[0]), length, compressed);
 
-            // append to the buffer and if the buffer is full write to the file
-            insertToBuffer(buffer, &buff_index, &write_index, &nBlocks, compressed, symbol_length, symbol, bufferSize);
+        } else {
+#ifdef INTERLEAVED_LANES
+            putLaneBytes(&lanes, &writer, data, length, symbols);
+#else
+            putBytes(&writer, data, length, symbols, pair_codes, vector_codes);
+#endif
         }
-    }
 
-    // The final buffer may not be full. In that case the rest of the block bits will be 0 and will be counted as padding
-
-    // if the buffer index is not 0 or the write index is not 7 the last buffer was not full
-    if (buff_index != 0 || write_index != SYM_BUFF_SIZE - 1) {
+        i += length;
+    }
 
-        // Update the number of padding bits. Every buffer element is SYM_BUFF_SIZE bits
-        nPaddingBits += SYM_BUFF_SIZE * (bufferSize - buff_index - 1);
+    free(data);
+    free(pair_codes);
 
-        // zero the remaining bits in the buffer[buff_index]
-        if (write_index != SYM_BUFF_SIZE - 1) {
+#ifdef INTERLEAVED_LANES
+    // The last frame of the lanes
+    closeLaneEncoder(&lanes, &writer);
+#endif
 
-            // Align the last SYM_BUFF_SIZE bits
-            buffer[buff_index] = buffer[buff_index] << (write_index + 1);
+    // The last block is padded with 0 bits
+    uint32_t padding;
+    uint64_t written_blocks;
 
-            nPaddingBits += write_index + 1;  // add the final padding bits
-        }
+    if (stored) {
+        padding = streamPadding(8 * (uint64_t) file_len, blockSize);
+        written_blocks = streamBlocks(8 * (uint64_t) file_len, blockSize);
 
-        // write the buffer to the file
-        fwrite(buffer, sizeof(buffer[0]), bufferSize, compressed);
+        auto *zeros = (uint8_t *) calloc(padding / 8 + 1, sizeof(uint8_t));
+        fwrite(zeros, sizeof(zeros[0]), padding / 8, compressed);
+        free(zeros);
 
-        nBlocks++;
+    } else {
+        padding = closeBitWriter(&writer);
+        written_blocks = writer.n_blocks;
     }
 
+#ifdef PATCH_HEADER
+    nPaddingBits = padding;
+    nBlocks = written_blocks;
+
     // update the number of padding bits and the number of blocks written tho the compressed file
     rewind(compressed);
 
@@ -200,8 +191,91 @@ void compressFile(const std::string& filename, const std::string& output_filenam
 
     // Write the number of blocks.
     fwrite(&nBlocks, sizeof(nBlocks), 1, compressed);
+#else
+    // The stream must end where it was planned
+    if (padding != nPaddingBits || written_blocks != nBlocks) {
+        std::cout << "Wrote " << written_blocks << " blocks and " << padding << " padding bits instead of the planned "
+                  << nBlocks << " and " << nPaddingBits << std::endl;
+        exit(-1);
+    }
+#endif
 
-    free(buffer);
     fclose(compressed);
     fclose(file);
-}
\ No newline at end of file
+
+#ifdef SPARSE_FILES
+    // The extent map is stored after the compressed data
+    appendSparseMap(output_filename, &map);
+    freeSparseMap(&map);
+#endif
+}
+
+
+
+/**
+ * Takes the file to be compressed reads the bits and creates a new compressed file. The compressed file has the
+ * following format:
+ *
+ *      The fields follow each other in this order. The table has a variable size, so the offset of the data depends on
+ *      its kind:
+ *
+ *      uint32_t       The number of the padding bits added to the end of the file
+ *      uint32_t       The number of blocks in the file
+ *      uint16_t       The block size used to group data
+ *      uint8_t        (STORED_SECTIONS) Whether the file is stored. A stored file has no table
+ *      table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by the
+ *                     symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES), the id of a
+ *                     shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h
+ *      data           The compressed data
+ *                     (INTERLEAVED_LANES) The data is a sequence of lane frames (see lanes.h)
+ *                     (STORED_SECTIONS) The data of a stored file is its characters padded with 0 bytes to a whole
+ *                     block
+ *      extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
+ *
+ * @param filename         The name of the file to be compressed
+ * @param output_filename  The name of the compressed file
+ * @param huffman          The huffman struct that contains the information for the compression
+ * @param blockSize        The size in bytes of the data that every write operation writes to the file. (must be power of 2)
+ */
+void compressFile(const std::string& filename, const std::string& output_filename, ASCIIHuffman *huffman, uint16_t blockSize) {
+    dispatchCodeWord(huffman, [&](auto code_word) {
+        compressFileWidth<decltype(code_word)>(filename, output_filename, huffman, blockSize);
+    });
+}
+
+#ifdef FUSED_MODE
+
+/**
+ * Compresses the file in a single pass (fused mode). Every chunk is read once, counted and encoded with its table while
+ * it is still in the cache. The compressed file has the format described in fused.h.
+ *
+ * @param filename         The name of the file to be compressed
+ * @param output_filename  The name of the compressed file
+ */
+void compressFileFused(const std::string& filename, const std::string& output_filename) {
+    FILE *file = openBinaryFile(filename, "rb");
+    FILE *compressed = openBinaryFile(output_filename, "wb");
+
+    writeFusedHeader(compressed, fileSize(filename));
+
+    FusedChunk chunk;
+    initFusedChunk(&chunk);
+
+    FusedTable table;
+
+    // Read, encode and write the chunks one by one
+    while ((chunk.n_chars = fread(chunk.data, sizeof(chunk.data[0]), FUSED_CHUNK_SIZE, file)) > 0) {
+        countFusedChunk(&chunk);
+        chooseFusedTable(&chunk, &table);
+        encodeFusedChunk(&chunk);
+
+        writeFusedChunk(compressed, &chunk);
+    }
+
+    freeFusedChunk(&chunk);
+
+    fclose(compressed);
+    fclose(file);
+}
+
+#endif
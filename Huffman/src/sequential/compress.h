@@ -3,16 +3,34 @@
 
 #include "../structs.h"
 
+/*
+ * The stream is planned from the exact frequencies of the file (see stream.h), so the header is written once and the
+ * compressed file is written from start to end (it can be a pipe). The sampled frequencies and the presets are not
+ * exact, so with them the header is patched after the data instead.
+ */
+#if defined(TABLE_PRESET) || (defined(SAMPLE_FREQUENCIES) && !defined(SPARSE_FILES))
+#define PATCH_HEADER
+#endif
+
 /**
  * Takes the file to be compressed reads the bits and creates a new compressed file. The compressed file has the
  * following format:
  *
- *      Byte 0:3       The number of the padding bits added to the end of the file (uint32_t)
- *      Byte 4:7       The number of blocks in the file (uint32_t)
- *      Byte 8:9       The block size used to group data (uint16_t)
- *      Byte 10:8457   The huffman table used to compress the file. After every 256 bit symbol the number of bits used
- *                     by the symbol are written as well as an 8 bit number. The size of the table is 256 x (256 + 8) bits
- *      Byte 8457:end  The compressed data
+ *      The fields follow each other in this order. The table has a variable size, so the offset of the data depends on
+ *      its kind:
+ *
+ *      uint32_t       The number of the padding bits added to the end of the file
+ *      uint32_t       The number of blocks in the file
+ *      uint16_t       The block size used to group data
+ *      uint8_t        (STORED_SECTIONS) Whether the file is stored. A stored file has no table
+ *      table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by the
+ *                     symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES), the id of a
+ *                     shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h
+ *      data           The compressed data
+ *                     (INTERLEAVED_LANES) The data is a sequence of lane frames (see lanes.h)
+ *                     (STORED_SECTIONS) The data of a stored file is its characters padded with 0 bytes to a whole
+ *                     block
+ *      extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  * @param filename         The name of the file to be compressed
  * @param output_filename  The name of the compressed file
@@ -21,4 +39,18 @@
  */
 void compressFile(const std::string& filename, const std::string& output_filename, ASCIIHuffman *huffman, uint16_t blockSize);
 
+
+#ifdef FUSED_MODE
+
+/**
+ * Compresses the file in a single pass (fused mode). Every FUSED_CHUNK_SIZE chunk is counted and encoded with its own
+ * huffman table. The format of the compressed file is described in fused.h.
+ *
+ * @param filename         The name of the file to be compressed
+ * @param output_filename  The name of the compressed file
+ */
+void compressFileFused(const std::string& filename, const std::string& output_filename);
+
+#endif
+
 #endif
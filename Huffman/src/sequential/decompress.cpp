@@ -6,6 +6,10 @@
 
 #include "decompress.h"
 #include "../file_utils.h"
+#include "../fused.h"
+#include "../sparse.h"
+#include "../lanes.h"
+#include "../decode_table.h"
 
 #define CHAR_BUFF_SIZE 2048  // The size of the write buffer
 #define SYM_BUFF_SIZE 128   // The size of the read buffer single element
@@ -29,7 +33,8 @@
  * @param c_index        The index of the character buffer
  * @param decompressed   The pointer of the decompressed file
  */
-inline void decodeBuffer(HuffmanNode *nodes, uint16_t root_index, HuffmanNode *node, uint128_t *buffer, uint16_t buffer_start,
+template <typename CodeWord>
+inline void decodeBuffer(HuffmanNodeT<CodeWord> *nodes, uint16_t root_index, HuffmanNodeT<CodeWord> *node, uint128_t *buffer, uint16_t buffer_start,
                          uint16_t buffer_size, uint8_t element_size, uint8_t *char_buffer, uint32_t *c_index,
                          FILE *decompressed){
 
@@ -77,22 +82,164 @@ inline void decodeBuffer(HuffmanNode *nodes, uint16_t root_index, HuffmanNode *n
 }
 
 
+#ifdef TABLE_DECODING
+/**
+ * Decodes the compressed data of a file with the decode table of its symbols (TABLE_DECODING)
+ *
+ * @param file          The compressed file (at the start of the compressed data)
+ * @param decompressed  The decompressed file
+ * @param huffman       The huffman struct with the symbols
+ * @param padding_bits  The number of padding bits of the last block
+ * @param n_blocks      The number of blocks
+ * @param block_size    The size of the blocks in bits
+ */
+void decodeFile(FILE *file, FILE *decompressed, ASCIIHuffman *huffman, uint32_t padding_bits, uint32_t n_blocks,
+                uint16_t block_size) {
+    // The symbols are decoded from the stream up to the padding of the last block
+    BitReader reader;
+    openBitReader(&reader, file, 0);
+
+    uint64_t n_bits = (uint64_t) n_blocks * block_size - padding_bits;
+
+    // Every symbol is decoded with a lookup of its first bits
+    DecodeTable table;
+    buildDecodeTable(&table, huffman);
+
+#ifdef INTERLEAVED_LANES
+    decodeLanesTable(&table, &reader, n_bits, decompressed);
+#else
+    decodeTableStream(&table, &reader, n_bits, decompressed);
+#endif
+
+    freeDecodeTable(&table);
+    closeBitReader(&reader);
+}
+
+#else
+
+/**
+ * Decodes the compressed data of a file by walking a tree of nodes with a code word type
+ *
+ * @param file          The compressed file (at the start of the compressed data)
+ * @param decompressed  The decompressed file
+ * @param huffman       The huffman struct with the symbols
+ * @param padding_bits  The number of padding bits of the last block
+ * @param n_blocks      The number of blocks
+ * @param block_size    The size of the blocks in bits
+ */
+template <typename CodeWord>
+void decodeFileTree(FILE *file, FILE *decompressed, ASCIIHuffman *huffman, uint32_t padding_bits, uint32_t n_blocks,
+                    uint16_t block_size) {
+    // The huffman tree
+    HuffmanNodeT<CodeWord> nodes[511];
+    uint16_t root_index = huffmanFromArray(huffman, nodes);
+
+#ifdef DEBUG_MODE
+    cout << "Created tree:" << endl;
+    printTree(nodes, root_index);
+#endif
+
+#ifdef INTERLEAVED_LANES
+    // The lanes are decoded from the stream up to the padding of the last block
+    BitReader reader;
+    openBitReader(&reader, file, 0);
+
+    uint64_t n_bits = (uint64_t) n_blocks * block_size - padding_bits;
+
+    decodeLanes(nodes, root_index, &reader, n_bits, decompressed);
+
+    closeBitReader(&reader);
+#else
+    /*
+     * Start reading the file from start to finish. Reading one bit at a time and navigating the tree until a leaf node
+     * is reached.
+     */
+    uint16_t buffer_size = block_size / SYM_BUFF_SIZE;
+
+    /*
+     * The buffer holds the data to be written to the file. Once the buffer is full the data are written to the file
+     * and the buffer is overwritten with the next part of data. The process repeats until the end
+     */
+    auto *buffer = (uint128_t *) calloc(buffer_size, sizeof(uint128_t));
+
+
+    uint8_t char_buffer[CHAR_BUFF_SIZE];    // The decompressed character
+    uint32_t c_index = 0;         // The character buffer index
+
+    HuffmanNodeT<CodeWord> node = nodes[root_index];  // The current node of the tree.
+
+    // If the file has only one block skip to the final block handling
+    if (n_blocks > 1) {
+        // For all the blocks in the file except the last one...
+        do {
+            // read the symbol bits from the compressed file
+            fread(&buffer[0], sizeof(buffer[0].lower()), buffer_size * 2, file);
+
+            // decode the buffer
+            decodeBuffer(nodes, root_index, &node, buffer, 0, buffer_size, SYM_BUFF_SIZE,
+                         char_buffer, &c_index, decompressed);
+
+            // Update the remaining blocks number
+            n_blocks--;
+
+        } while (n_blocks != 1);
+    }
+
+    // The last block may contain padding bits that shouldn't be interpreted as symbols
+    fread(&buffer[0], sizeof(buffer[0].lower()), buffer_size * 2, file);  // Read the last block
+
+    // Get the number of full elements of the buffer
+    buffer_size -= padding_bits / SYM_BUFF_SIZE;
+
+    // decode the buffer except the last buffer element
+    decodeBuffer(nodes, root_index, &node, buffer, 0, buffer_size - 1, SYM_BUFF_SIZE,
+                 char_buffer, &c_index, decompressed);
+
+    // The last element that contains symbol bits may contain some padding bits also
+    // The number of symbol bits on the last element of the buffer
+    uint8_t useful_bits = SYM_BUFF_SIZE - padding_bits % SYM_BUFF_SIZE;
+
+    // decode the last element of the buffer
+    decodeBuffer(nodes, root_index, &node, buffer, buffer_size - 1, buffer_size, useful_bits,
+                 char_buffer, &c_index, decompressed);
+
+    // Write the remaining chars
+    fwrite(char_buffer, sizeof(char_buffer[0]), c_index, decompressed);
+
+    free(buffer);
+#endif
+}
+#endif
+
+
 /**
  * Decompresses a file. The steps to decompress the file are the following:
  *
  *   Step 1: Read the meta data from of the file.
  *
- *           Byte 0:3       The number of the padding bits added to the end of the file (uint32_t)
+ *           The fields follow each other in this order. The table has a variable size, so the offset of the data
+ *           depends on its kind:
+ *
+ *           uint32_t       The number of the padding bits added to the end of the file
+ *
+ *           uint32_t       The number of blocks in the file
+ *
+ *           uint16_t       The block size used to group data
+ *
+ *           uint8_t        (STORED_SECTIONS) Whether the file is stored. A stored file has no table
+ *
+ *           table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by
+ *                          the symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES),
+ *                          the id of a shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h
  *
- *           Byte 4:7       The number of blocks in the file (uint32_t)
+ *           data           The compressed data
  *
- *           Byte 8:9       The block size used to group data (uint16_t)
+ *                          (INTERLEAVED_LANES) The data is a sequence of lane frames (see lanes.h)
  *
- *           Byte 10:8457   The huffman table used to compress the file. After every 256 bit symbol the number of bits
- *                          used by the symbol are written as well as an 8 bit number.
- *                          The size of the table is 256 x (256 + 8) bits
+ *                          (STORED_SECTIONS) The data of a stored file is its characters padded with 0 bytes to a whole
+ *                          block
  *
- *           Byte 8457:end  The compressed data
+ *           extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  *   Step 2: Create the Huffman tree from the huffman table
  *
@@ -131,13 +278,17 @@ void decompressFile(const std::string& filename, const std::string& decompressed
     fread(&n_blocks, sizeof(n_blocks), 1, file);
     fread(&block_size, sizeof(block_size), 1, file);
 
+    uint8_t stored = 0;  // 1 if the characters are stored as they are
+
+#ifdef STORED_SECTIONS
+    fread(&stored, sizeof(stored), 1, file);
+#endif
+
     // Retrieve the huffman info
     ASCIIHuffman huffman;
 
-    for (Symbol &symbol : huffman.symbols) {
-        // Read all the symbols from the file
-        fread(&symbol.symbol, sizeof(huffman.symbols[0].symbol), 1, file);
-        fread(&symbol.symbol_length, sizeof(huffman.symbols[0].symbol_length), 1, file);
+    if (stored == 0) {
+        readHuffmanTable(file, &huffman, filename);
     }
 
 #ifdef DEBUG_MODE
@@ -150,71 +301,61 @@ void decompressFile(const std::string& filename, const std::string& decompressed
     }
 #endif
 
-    // The huffman tree
-    HuffmanNode nodes[511];
-    uint16_t root_index = huffmanFromArray(&huffman, nodes);
+    if (stored == 1) {
+        // The characters are copied by the kernel up to the padding of the last block
+        uint64_t n_chars = ((uint64_t) n_blocks * block_size - padding_bits) / 8;
 
-#ifdef DEBUG_MODE
-    cout << "Created tree:" << endl;
-    printTree(nodes, root_index);
+        copyFileRange(fileno(file), ftell(file), fileno(decompressed), 0, n_chars);
+
+    } else {
+#ifdef TABLE_DECODING
+        decodeFile(file, decompressed, &huffman, padding_bits, n_blocks, block_size);
+#else
+        dispatchCodeWord(&huffman, [&](auto code_word) {
+            decodeFileTree<decltype(code_word)>(file, decompressed, &huffman, padding_bits, n_blocks, block_size);
+        });
 #endif
+    }
 
-    /*
-     * Start reading the file from start to finish. Reading one bit at a time and navigating the tree until a leaf node
-     * is reached.
-     */
-    uint16_t buffer_size = block_size / SYM_BUFF_SIZE;
+    fclose(decompressed);
+    fclose(file);
 
-    /*
-     * The buffer holds the data to be written to the file. Once the buffer is full the data are written to the file
-     * and the buffer is overwritten with the next part of data. The process repeats until the end
-     */
-    auto *buffer = (uint128_t *) calloc(buffer_size, sizeof(uint128_t));
+#ifdef SPARSE_FILES
+    // The decompressed file contains only the data extents. Move them to their offsets and recreate the holes
+    restoreSparseFile(filename, decompressed_filename);
+#endif
+}
 
 
-    uint8_t char_buffer[CHAR_BUFF_SIZE];    // The decompressed character
-    uint32_t c_index = 0;         // The character buffer index
+#ifdef FUSED_MODE
 
-    HuffmanNode node = nodes[root_index];  // The current node of the tree.
+/**
+ * Decompresses a file compressed in fused mode. Every chunk is read with its table and decoded to the decompressed file.
+ *
+ * @param filename               The name of the file to be decompressed
+ * @param decompressed_filename  The name of the decompressed file
+ */
+void decompressFileFused(const std::string& filename, const std::string& decompressed_filename) {
+    FILE *file = openBinaryFile(filename, "rb");
+    FILE *decompressed = openBinaryFile(decompressed_filename, "wb");
 
-    // If the file has only one block skip to the final block handling
-    if (n_blocks > 1) {
-        // For all the blocks in the file except the last one...
-        do {
-            // read the symbol bits from the compressed file
-            fread(&buffer[0], sizeof(buffer[0].lower()), buffer_size * 2, file);
+    uint64_t n_chunks = readFusedHeader(file);
 
-            // decode the buffer
-            decodeBuffer(nodes, root_index, &node, buffer, 0, buffer_size, SYM_BUFF_SIZE,
-                         char_buffer, &c_index, decompressed);
+    FusedChunk chunk;
+    initFusedChunk(&chunk);
 
-            // Update the remaining blocks number
-            n_blocks--;
+    for (uint64_t i = 0; i < n_chunks; ++i) {
+        // The chunk keeps the table of the previous chunk if no table is stored with it
+        readFusedChunk(file, &chunk, &chunk);
+        decodeFusedChunk(&chunk);
 
-        } while (n_blocks != 1);
+        fwrite(chunk.data, sizeof(chunk.data[0]), chunk.n_chars, decompressed);
     }
 
-    // The last block may contain padding bits that shouldn't be interpreted as symbols
-    fread(&buffer[0], sizeof(buffer[0].lower()), buffer_size * 2, file);  // Read the last block
-
-    // Get the number of full elements of the buffer
-    buffer_size -= padding_bits / SYM_BUFF_SIZE;
-
-    // decode the buffer except the last buffer element
-    decodeBuffer(nodes, root_index, &node, buffer, 0, buffer_size - 1, SYM_BUFF_SIZE,
-                 char_buffer, &c_index, decompressed);
-
-    // The last element that contains symbol bits may contain some padding bits also
-    // The number of symbol bits on the last element of the buffer
-    uint8_t useful_bits = SYM_BUFF_SIZE - padding_bits % SYM_BUFF_SIZE;
-
-    // decode the last element of the buffer
-    decodeBuffer(nodes, root_index, &node, buffer, buffer_size - 1, buffer_size, useful_bits,
-                 char_buffer, &c_index, decompressed);
-
-    // Write the remaining chars
-    fwrite(char_buffer, sizeof(char_buffer[0]), c_index, decompressed);
+    freeFusedChunk(&chunk);
 
     fclose(decompressed);
     fclose(file);
-}
\ No newline at end of file
+}
+
+#endif
@@ -6,17 +6,29 @@
  *
  *   Step 1: Read the meta data from of the file.
  *
- *           Byte 0:3       The number of the padding bits added to the end of the file (uint32_t)
+ *           The fields follow each other in this order. The table has a variable size, so the offset of the data
+ *           depends on its kind:
  *
- *           Byte 4:7       The number of blocks in the file (uint32_t)
+ *           uint32_t       The number of the padding bits added to the end of the file
  *
- *           Byte 8:9       The block size used to group data (uint16_t)
+ *           uint32_t       The number of blocks in the file
  *
- *           Byte 10:8457   The huffman table used to compress the file. After every 256 bit symbol the number of bits
- *                          used by the symbol are written as well as an 8 bit number.
- *                          The size of the table is 256 x (256 + 8) bits
+ *           uint16_t       The block size used to group data
  *
- *           Byte 8457:end  The compressed data
+ *           uint8_t        (STORED_SECTIONS) Whether the file is stored. A stored file has no table
+ *
+ *           table          The huffman table used to compress the file. It starts with its kind (uint8_t) followed by
+ *                          the symbols of a full table, the encoded lengths of a canonical table (CANONICAL_TABLES),
+ *                          the id of a shared table (batch mode) or the id of a preset (TABLE_PRESET), see huffman.h
+ *
+ *           data           The compressed data
+ *
+ *                          (INTERLEAVED_LANES) The data is a sequence of lane frames (see lanes.h)
+ *
+ *                          (STORED_SECTIONS) The data of a stored file is its characters padded with 0 bytes to a whole
+ *                          block
+ *
+ *           extents        (SPARSE_FILES) The extent map of the input file after the data (see sparse.h)
  *
  *   Step 2: Create the Huffman tree from the huffman table
  *
@@ -27,4 +39,17 @@
  */
 void decompressFile(const std::string& filename, const std::string& decompressed_filename);
 
+
+#ifdef FUSED_MODE
+
+/**
+ * Decompresses a file compressed with compressFileFused (see fused.h for the format)
+ *
+ * @param filename               The name of the file to be decompressed
+ * @param decompressed_filename  The name of the decompressed file
+ */
+void decompressFileFused(const std::string& filename, const std::string& decompressed_filename);
+
+#endif
+
 #endif
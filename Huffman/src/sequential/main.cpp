@@ -4,6 +4,11 @@
 #include "../structs.h"
 #include "../huffman.h"
 #include "../file_utils.h"
+#include "../freq_cache.h"
+#include "../histogram.h"
+#include "../presets.h"
+#include "../bit_writer.h"
+#include "../stream.h"
 #include "char_frequency.h"
 #include "compress.h"
 #include "decompress.h"
@@ -22,9 +27,21 @@ int main(int argc, char **argv) {
     Timer overall_timer;
     Timer all;
 
+    // Training mode. A table preset is trained from the corpus files and stored (see presets.h)
+    if (argc > 3 && string(argv[1]) == "--train") {
+        uint8_t lengths[256];
+
+        trainPreset(argv + 3, argc - 3, lengths);
+        storePreset(argv[2], lengths);
+
+        return 0;
+    }
+
     if (argc != 2) {
         cout << "Wrong number of arguments. Expected 1 got " << argc - 1 << endl;
         cout << "To run this executable run sequential.out path/to/data/file" << endl;
+        cout << "To train a table preset run sequential.out --train preset_name path/to/corpus1 path/to/corpus2 ..."
+             << endl;
         return -1;
     }
 
@@ -42,17 +59,75 @@ int main(int argc, char **argv) {
     startTimer(&overall_timer);
     startTimer(&all);
 
+#ifdef FUSED_MODE
+    // The frequencies, the table and the compressed data of every chunk are created in a single pass
+    cout << "Compressing file in fused mode (" << FUSED_CHUNK_SIZE << " byte chunks)..." << endl;
+
+    startTimer(&timer);
+
+    compressFileFused(input_file_name, output_file_name);
+
+    stopTimer(&timer);
+
+    cout << "Compression elapsed time: ";
+    displayElapsed(&timer);
+    displayThroughput(&timer, fileSize(input_file_name));
+#else
+#ifdef TABLE_PRESET
+    // The symbols of the preset are used, so neither the frequencies nor the tree are calculated
+    cout << "Loading the table preset " << TABLE_PRESET << "..." << endl;
+
+    startTimer(&timer);
+
+    loadPreset(TABLE_PRESET, &huffman);
+
+    stopTimer(&timer);
+
+    cout << "Preset elapsed time: ";
+    displayElapsed(&timer);
+#else
     cout << "Calculating frequencies..." << endl;
 
     startTimer(&timer);
 
+#ifdef FREQUENCY_CACHE
+    // Skip the frequency pass if the frequencies of the file are cached. The compressor plans the stream from exact
+    // frequencies unless it patches the header
+#ifdef PATCH_HEADER
+    bool exact_only = false;
+#else
+    bool exact_only = true;
+#endif
+
+    if (loadFrequencyCache(input_file_name, &huffman, 0, exact_only)) {
+        cout << "Frequencies loaded from " << input_file_name << FREQ_CACHE_EXTENSION << endl;
+
+    } else {
+        charFrequency(input_file_name, &huffman);
+
+#ifdef PATCH_HEADER
+        storeFrequencyCache(input_file_name, &huffman, 0, false);  // The frequencies are estimated
+#else
+        storeFrequencyCache(input_file_name, &huffman, 0, true);
+#endif
+    }
+#else
     charFrequency(input_file_name, &huffman);
+#endif
 
     stopTimer(&timer);
 
     cout << "Frequency elapsed time: ";
     displayElapsed(&timer);
 
+    // The size of the input file is the sum of all the frequencies
+    uint64_t input_size = 0;
+    for (uint64_t freq : huffman.charFreq) {
+        input_size += freq;
+    }
+
+    displayThroughput(&timer, input_size);
+
     #ifdef DEBUG_MODE
         cout << "Characters frequency: " << endl;
 
@@ -74,6 +149,7 @@ int main(int argc, char **argv) {
 
     cout << "Symbols elapsed time: ";
     displayElapsed(&timer);
+#endif
 
     #ifdef DEBUG_MODE
         cout << "\n\nHuffman symbols: \n" << endl;
@@ -84,16 +160,52 @@ int main(int argc, char **argv) {
         }
     #endif
 
-    cout << "Compressing file..." << endl;
+    cout << "Compressing file (" << encodeKernelName() << " kernel)..." << endl;
 
     startTimer(&timer);
 
     compressFile(input_file_name, output_file_name, &huffman, 8192 * 4);
 
+    // A stored preset is referenced as a shared table
+    if (huffman.table_id != 0) {
+        storeSharedTable(output_file_name, &huffman);
+    }
+
     stopTimer(&timer);
 
     cout << "Compression elapsed time: ";
     displayElapsed(&timer);
+    displayThroughput(&timer, fileSize(input_file_name));
+
+#if defined(SAMPLE_FREQUENCIES) && !defined(TABLE_PRESET)
+    // Compare the size predicted from the sampled frequencies with the real size of the compressed file. The header is
+    // the padding bits, the number of blocks and the block size followed by the stored flag (STORED_SECTIONS) and the
+    // table of the file (none if the file is stored)
+    uint64_t block_bits = 8192 * 4;
+    uint64_t data_bits = encodedBits(huffman.charFreq, &huffman);
+    uint64_t header_size = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t);
+
+#ifdef STORED_SECTIONS
+    header_size += sizeof(uint8_t);
+
+    if (storedStream(huffman.charFreq, &huffman, 8 * (uint64_t) huffmanTableSize(&huffman))) {
+        data_bits = 8 * fileSize(input_file_name);
+    } else {
+        header_size += huffmanTableSize(&huffman);
+    }
+#else
+    header_size += huffmanTableSize(&huffman);
+#endif
+
+    uint64_t predicted_blocks = (data_bits + block_bits - 1) / block_bits;
+    uint64_t predicted_size = header_size + predicted_blocks * block_bits / 8;
+    uint64_t actual_size = fileSize(output_file_name);
+
+    cout << "Predicted compressed size: " << predicted_size << " bytes, actual: " << actual_size << " bytes ("
+         << 100.0 * ((double) actual_size - (double) predicted_size) / (double) predicted_size << "%)\n" << endl;
+#endif
+
+#endif
 
     stopTimer(&overall_timer);
 
@@ -104,7 +216,11 @@ int main(int argc, char **argv) {
 
     startTimer(&timer);
 
+#ifdef FUSED_MODE
+    decompressFileFused(output_file_name, decompressed_file_name);
+#else
     decompressFile(output_file_name, decompressed_file_name);
+#endif
 
     stopTimer(&timer);
 
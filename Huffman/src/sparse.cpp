@@ -0,0 +1,382 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sparse.h"
+#include "histogram.h"
+
+#define SPARSE_COPY_SIZE (1024 * 1024)  // The size of the buffer used to move the extents (1MB)
+
+//#define DEBUG_MODE
+
+
+/**
+ * Appends an extent to a map. The extents array grows by doubling.
+ *
+ * @param map     The map
+ * @param offset  The offset of the extent in the file
+ * @param length  The length of the extent
+ */
+void addExtent(SparseMap *map, uint64_t offset, uint64_t length) {
+    // The array is full when the number of extents is a power of 2
+    if ((map->n_extents & (map->n_extents - 1)) == 0) {
+        uint32_t capacity = map->n_extents == 0 ? 1 : map->n_extents * 2;
+        map->extents = (Extent *) realloc(map->extents, capacity * sizeof(Extent));
+    }
+
+    map->extents[map->n_extents].offset = offset;
+    map->extents[map->n_extents].length = length;
+    map->extents[map->n_extents].data_offset = map->data_size;
+
+    map->n_extents++;
+    map->data_size += length;
+}
+
+
+/**
+ * Finds the data extents of a file with lseek(SEEK_DATA/SEEK_HOLE). If the file system does not report holes the whole
+ * file is a single extent.
+ *
+ * @param filename  The file name
+ * @param map       The map to fill (free it with freeSparseMap)
+ */
+void readSparseMap(const std::string& filename, SparseMap *map) {
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        std::cout << "File not found..." << std::endl;
+        exit(-1);
+    }
+
+    map->extents = nullptr;
+    map->n_extents = 0;
+    map->data_size = 0;
+    map->file_size = (uint64_t) lseek(fd, 0, SEEK_END);
+
+    off_t position = 0;
+
+    while ((uint64_t) position < map->file_size) {
+        off_t data = lseek(fd, position, SEEK_DATA);
+
+        // There is no data after this position, the rest of the file is a hole
+        if (data < 0 && errno == ENXIO) {
+            break;
+        }
+
+        // SEEK_DATA is not supported. The rest of the file is treated as data
+        if (data < 0) {
+            addExtent(map, position, map->file_size - position);
+            break;
+        }
+
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+
+        if (hole < 0 || (uint64_t) hole > map->file_size) {
+            hole = (off_t) map->file_size;
+        }
+
+        addExtent(map, data, hole - data);
+
+        position = hole;
+    }
+
+    close(fd);
+
+#ifdef DEBUG_MODE
+    for (uint32_t i = 0; i < map->n_extents; ++i) {
+        std::cout << "Extent " << i << ": " << map->extents[i].offset << " + " << map->extents[i].length << std::endl;
+    }
+#endif
+}
+
+
+/**
+ * Frees the extents of a map
+ *
+ * @param map  The map
+ */
+void freeSparseMap(SparseMap *map) {
+    free(map->extents);
+
+    map->extents = nullptr;
+    map->n_extents = 0;
+}
+
+
+/**
+ * Finds the extent that contains a byte of the data stream (binary search)
+ *
+ * @param map          The map
+ * @param data_offset  The offset in the data stream (less than data_size)
+ * @return             The index of the extent
+ */
+uint32_t findExtent(const SparseMap *map, uint64_t data_offset) {
+    uint32_t low = 0;
+    uint32_t high = map->n_extents - 1;
+
+    while (low < high) {
+        uint32_t middle = (low + high + 1) / 2;
+
+        if (map->extents[middle].data_offset <= data_offset) {
+            low = middle;
+
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
+
+
+/**
+ * Counts the frequency of every byte of a part of the data stream. Only the data extents are read.
+ *
+ * @param file           The file to count the frequencies
+ * @param map            The map of the file
+ * @param start_byte     The first byte of the data stream to count (inclusive)
+ * @param end_byte       The last byte of the data stream to count (exclusive)
+ * @param frequency_arr  The frequency array (256 elements) the counts are added to
+ */
+void countSparseRange(FILE *file, const SparseMap *map, uint64_t start_byte, uint64_t end_byte, uint64_t *frequency_arr) {
+    if (start_byte >= end_byte) {
+        return;
+    }
+
+    for (uint32_t i = findExtent(map, start_byte); i < map->n_extents; ++i) {
+        const Extent *extent = &map->extents[i];
+
+        if (extent->data_offset >= end_byte) {
+            break;
+        }
+
+        // The part of the extent inside the range
+        uint64_t first = start_byte > extent->data_offset ? start_byte - extent->data_offset : 0;
+        uint64_t last = end_byte - extent->data_offset < extent->length ? end_byte - extent->data_offset : extent->length;
+
+        countFileRange(file, extent->offset + first, extent->offset + last, frequency_arr);
+    }
+}
+
+
+/**
+ * Reads a part of the data stream with pread. The read is split at the extent boundaries.
+ *
+ * @param fd           The file descriptor
+ * @param map          The map of the file
+ * @param buffer       The buffer to read to
+ * @param length       The number of bytes to read
+ * @param data_offset  The offset of the first byte in the data stream
+ * @return             The number of bytes read
+ */
+ssize_t preadData(int fd, const SparseMap *map, uint8_t *buffer, uint64_t length, uint64_t data_offset) {
+    if (length == 0 || data_offset >= map->data_size) {
+        return 0;
+    }
+
+    ssize_t total = 0;
+
+    for (uint32_t i = findExtent(map, data_offset); i < map->n_extents && length > 0; ++i) {
+        const Extent *extent = &map->extents[i];
+
+        uint64_t first = data_offset - extent->data_offset;
+        uint64_t size = extent->length - first < length ? extent->length - first : length;
+
+        ssize_t n_read = pread(fd, buffer + total, size, (off_t) (extent->offset + first));
+
+        if (n_read <= 0) {
+            break;
+        }
+
+        total += n_read;
+        length -= n_read;
+        data_offset += n_read;
+    }
+
+    return total;
+}
+
+
+/**
+ * Seeks a file to a byte of the data stream. The compressors read the file sequentially and seek again once they reach
+ * the end of the current extent.
+ *
+ * @param file         The file
+ * @param map          The map of the file
+ * @param data_offset  The offset in the data stream
+ * @return             The offset in the data stream where the current extent ends
+ */
+uint64_t seekData(FILE *file, const SparseMap *map, uint64_t data_offset) {
+    if (data_offset >= map->data_size) {
+        return map->data_size;
+    }
+
+    const Extent *extent = &map->extents[findExtent(map, data_offset)];
+
+    fseek(file, (long) (extent->offset + data_offset - extent->data_offset), SEEK_SET);
+
+    return extent->data_offset + extent->length;
+}
+
+
+/**
+ * Appends the extents of a map to the end of a compressed file
+ *
+ * @param compressed_filename  The compressed file
+ * @param map                  The map of the input file
+ */
+void appendSparseMap(const std::string& compressed_filename, const SparseMap *map) {
+    FILE *compressed = fopen(compressed_filename.c_str(), "ab");
+
+    if (compressed == nullptr) {
+        std::cout << "Could not open " << compressed_filename << std::endl;
+        exit(-1);
+    }
+
+    for (uint32_t i = 0; i < map->n_extents; ++i) {
+        fwrite(&map->extents[i].offset, sizeof(map->extents[i].offset), 1, compressed);
+        fwrite(&map->extents[i].length, sizeof(map->extents[i].length), 1, compressed);
+    }
+
+    uint32_t magic = SPARSE_MAGIC;
+
+    fwrite(&map->file_size, sizeof(map->file_size), 1, compressed);
+    fwrite(&map->n_extents, sizeof(map->n_extents), 1, compressed);
+    fwrite(&magic, sizeof(magic), 1, compressed);
+
+    fclose(compressed);
+}
+
+
+/**
+ * Reads the extents stored in the trailer of a compressed file
+ *
+ * @param compressed_filename  The compressed file
+ * @param map                  The map to fill
+ */
+void loadSparseMap(const std::string& compressed_filename, SparseMap *map) {
+    FILE *compressed = fopen(compressed_filename.c_str(), "rb");
+
+    uint64_t file_size = 0;
+    uint32_t n_extents = 0;
+    uint32_t magic = 0;
+
+    if (compressed != nullptr && fseek(compressed, -16, SEEK_END) == 0) {
+        fread(&file_size, sizeof(file_size), 1, compressed);
+        fread(&n_extents, sizeof(n_extents), 1, compressed);
+        fread(&magic, sizeof(magic), 1, compressed);
+    }
+
+    if (magic != SPARSE_MAGIC) {
+        std::cout << "The compressed file has no extent map" << std::endl;
+        exit(-1);
+    }
+
+    map->extents = nullptr;
+    map->n_extents = 0;
+    map->data_size = 0;
+    map->file_size = file_size;
+
+    fseek(compressed, -16 - (long) (n_extents * 2 * sizeof(uint64_t)), SEEK_END);
+
+    for (uint32_t i = 0; i < n_extents; ++i) {
+        uint64_t extent[2];
+        fread(extent, sizeof(extent[0]), 2, compressed);
+
+        addExtent(map, extent[0], extent[1]);
+    }
+
+    fclose(compressed);
+}
+
+
+/**
+ * Turns a part of a file to a hole. If the file system can not punch holes the part is zeroed.
+ *
+ * @param fd      The file descriptor
+ * @param offset  The start of the hole
+ * @param length  The length of the hole
+ */
+void punchHole(int fd, uint64_t offset, uint64_t length) {
+    if (length == 0 || fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) offset, (off_t) length) == 0) {
+        return;
+    }
+
+    auto *zeros = (uint8_t *) calloc(SPARSE_COPY_SIZE, 1);
+
+    while (length > 0) {
+        uint64_t size = length < SPARSE_COPY_SIZE ? length : SPARSE_COPY_SIZE;
+
+        pwrite(fd, zeros, size, (off_t) offset);
+
+        offset += size;
+        length -= size;
+    }
+
+    free(zeros);
+}
+
+
+/**
+ * Restores the holes of a decompressed file. The decompressed file contains the data stream. The extents are moved to
+ * their offsets starting from the last one (an extent never moves to a lower offset) and the gaps between them are
+ * turned back to holes with fallocate(PUNCH_HOLE) and ftruncate.
+ *
+ * @param compressed_filename    The compressed file with the trailer
+ * @param decompressed_filename  The decompressed file
+ */
+void restoreSparseFile(const std::string& compressed_filename, const std::string& decompressed_filename) {
+    SparseMap map;
+    loadSparseMap(compressed_filename, &map);
+
+    int fd = open(decompressed_filename.c_str(), O_RDWR);
+
+    if (fd < 0) {
+        std::cout << "Could not open " << decompressed_filename << std::endl;
+        exit(-1);
+    }
+
+    // Only the data stream is kept (a file without data decodes to a padding block). Then the file grows to its original
+    // size and the new part is a hole
+    ftruncate(fd, (off_t) map.data_size);
+    ftruncate(fd, (off_t) map.file_size);
+
+    auto *buffer = (uint8_t *) malloc(SPARSE_COPY_SIZE);
+
+    // Move the extents starting from the last one. The extents before the first hole are already in place
+    for (int64_t i = (int64_t) map.n_extents - 1; i >= 0; --i) {
+        const Extent *extent = &map.extents[i];
+
+        if (extent->offset == extent->data_offset) {
+            break;
+        }
+
+        // The extent is copied from its end so an overlapping source is not overwritten before it is read
+        uint64_t remaining = extent->length;
+
+        while (remaining > 0) {
+            uint64_t size = remaining < SPARSE_COPY_SIZE ? remaining : SPARSE_COPY_SIZE;
+            remaining -= size;
+
+            pread(fd, buffer, size, (off_t) (extent->data_offset + remaining));
+            pwrite(fd, buffer, size, (off_t) (extent->offset + remaining));
+        }
+    }
+
+    free(buffer);
+
+    // The gaps between the extents still contain parts of the data stream
+    uint64_t end = 0;
+
+    for (uint32_t i = 0; i < map.n_extents; ++i) {
+        punchHole(fd, end, map.extents[i].offset - end);
+        end = map.extents[i].offset + map.extents[i].length;
+    }
+
+    close(fd);
+
+    freeSparseMap(&map);
+}
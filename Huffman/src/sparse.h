@@ -0,0 +1,117 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <cstdio>
+#include <string>
+#include <sys/types.h>
+
+#include "structs.h"
+
+/*
+ * Sparse files (VM and database images) are mostly holes. When SPARSE_FILES is defined only the data extents of the
+ * input file are read, counted and compressed. The holes are never read. The compressed data is the concatenation of
+ * the data extents (the data stream) and the extents are stored in a trailer after the compressed data:
+ *
+ *      Extent[n_extents]   The file offset and the length of every data extent (2 x uint64_t)
+ *      uint64_t            The size of the original file (holes included)
+ *      uint32_t            The number of extents
+ *      uint32_t            SPARSE_MAGIC
+ *
+ * The decompressors decode the data stream as usual and restoreSparseFile moves the extents to their offsets and
+ * punches the holes, so the decompressed file is sparse as well.
+ */
+
+#define SPARSE_MAGIC 0x53505253  // "SPRS"
+
+
+typedef struct extent {
+    uint64_t offset;       /// The offset of the extent in the file
+    uint64_t length;       /// The length of the extent in bytes
+    uint64_t data_offset;  /// The offset of the extent in the data stream (not stored in the trailer)
+} Extent;
+
+
+typedef struct sparse_map {
+    Extent *extents = nullptr;  /// The data extents of the file sorted by offset
+    uint32_t n_extents = 0;     /// The number of data extents
+
+    uint64_t file_size = 0;     /// The size of the file (holes included)
+    uint64_t data_size = 0;     /// The number of bytes in the data extents
+} SparseMap;
+
+
+/**
+ * Finds the data extents of a file with lseek(SEEK_DATA/SEEK_HOLE). If the file system does not report holes the whole
+ * file is a single extent.
+ *
+ * @param filename  The file name
+ * @param map       The map to fill (free it with freeSparseMap)
+ */
+void readSparseMap(const std::string& filename, SparseMap *map);
+
+
+/**
+ * Frees the extents of a map
+ *
+ * @param map  The map
+ */
+void freeSparseMap(SparseMap *map);
+
+
+/**
+ * Counts the frequency of every byte of a part of the data stream. Only the data extents are read.
+ *
+ * @param file           The file to count the frequencies
+ * @param map            The map of the file
+ * @param start_byte     The first byte of the data stream to count (inclusive)
+ * @param end_byte       The last byte of the data stream to count (exclusive)
+ * @param frequency_arr  The frequency array (256 elements) the counts are added to
+ */
+void countSparseRange(FILE *file, const SparseMap *map, uint64_t start_byte, uint64_t end_byte, uint64_t *frequency_arr);
+
+
+/**
+ * Reads a part of the data stream with pread. The read is split at the extent boundaries.
+ *
+ * @param fd           The file descriptor
+ * @param map          The map of the file
+ * @param buffer       The buffer to read to
+ * @param length       The number of bytes to read
+ * @param data_offset  The offset of the first byte in the data stream
+ * @return             The number of bytes read
+ */
+ssize_t preadData(int fd, const SparseMap *map, uint8_t *buffer, uint64_t length, uint64_t data_offset);
+
+
+/**
+ * Seeks a file to a byte of the data stream. The compressors read the file sequentially and seek again once they reach
+ * the end of the current extent.
+ *
+ * @param file         The file
+ * @param map          The map of the file
+ * @param data_offset  The offset in the data stream
+ * @return             The offset in the data stream where the current extent ends
+ */
+uint64_t seekData(FILE *file, const SparseMap *map, uint64_t data_offset);
+
+
+/**
+ * Appends the extents of a map to the end of a compressed file
+ *
+ * @param compressed_filename  The compressed file
+ * @param map                  The map of the input file
+ */
+void appendSparseMap(const std::string& compressed_filename, const SparseMap *map);
+
+
+/**
+ * Restores the holes of a decompressed file. The decompressed file contains the data stream. The extents are moved to
+ * their offsets starting from the last one (an extent never moves to a lower offset) and the gaps between them are
+ * turned back to holes with fallocate(PUNCH_HOLE) and ftruncate.
+ *
+ * @param compressed_filename    The compressed file with the trailer
+ * @param decompressed_filename  The decompressed file
+ */
+void restoreSparseFile(const std::string& compressed_filename, const std::string& decompressed_filename);
+
+#endif
@@ -0,0 +1,174 @@
+#include <iostream>
+
+#include "stream.h"
+#include "huffman.h"
+#include "lanes.h"
+
+#define ELEMENT_BITS 128  // The number of bits of an element of the stream
+
+//#define DEBUG_MODE
+
+
+/**
+ * Returns the exact number of bits of the stream of a file or a section: the symbols of its characters and the frame
+ * headers of the lanes (INTERLEAVED_LANES)
+ *
+ * @param frequencies  The exact frequencies of the characters (256 elements)
+ * @param huffman      The huffman struct with the symbols
+ * @return             The number of bits of the stream
+ */
+uint64_t streamBits(const uint64_t *frequencies, const ASCIIHuffman *huffman) {
+    uint64_t n_bits = encodedBits(frequencies, huffman);
+
+#ifdef INTERLEAVED_LANES
+    uint64_t n_chars = 0;
+
+    for (int i = 0; i < 256; ++i) {
+        n_chars += frequencies[i];
+    }
+
+    n_bits += laneHeaderBits(n_chars);
+#endif
+
+    return n_bits;
+}
+
+
+/**
+ * Returns whether a file or a section is stored (STORED_SECTIONS). It is stored if the symbols of its characters and
+ * the table only it needs would not make it smaller, then its stream is its 8 x n characters as they are.
+ *
+ * @param frequencies  The frequencies of the characters (256 elements)
+ * @param huffman      The huffman struct with the symbols
+ * @param table_bits   The bits of the table that is written only if the stream is encoded (0 for a shared table)
+ * @return             True if the characters are stored instead of encoded
+ */
+bool storedStream(const uint64_t *frequencies, const ASCIIHuffman *huffman, uint64_t table_bits) {
+    uint64_t n_chars = 0;
+
+    for (int i = 0; i < 256; ++i) {
+        n_chars += frequencies[i];
+    }
+
+    // An empty stream (or a preset without frequencies) is encoded
+    return n_chars > 0 && streamBits(frequencies, huffman) + table_bits >= 8 * n_chars;
+}
+
+
+/**
+ * Places the sections back to back in the stream. The n_bits of every section must be set.
+ *
+ * @param sections    The sections in the order of the file
+ * @param n_sections  The number of sections
+ * @return            The number of bits of the stream
+ */
+uint64_t placeStreamSections(StreamSection *sections, int n_sections) {
+    uint64_t n_bits = 0;
+
+    for (int i = 0; i < n_sections; ++i) {
+        sections[i].start_bit = n_bits;
+        n_bits += sections[i].n_bits;
+    }
+
+    return n_bits;
+}
+
+
+/**
+ * Returns the number of blocks of a stream. The last block is padded with 0 bits.
+ *
+ * @param n_bits      The number of bits of the stream
+ * @param block_size  The size of a block in bits
+ * @return            The number of blocks
+ */
+uint64_t streamBlocks(uint64_t n_bits, uint32_t block_size) {
+    return (n_bits + block_size - 1) / block_size;
+}
+
+
+/**
+ * Returns the number of padding bits of the last block of a stream
+ *
+ * @param n_bits      The number of bits of the stream
+ * @param block_size  The size of a block in bits
+ * @return            The number of padding bits
+ */
+uint32_t streamPadding(uint64_t n_bits, uint32_t block_size) {
+    return (uint32_t) (streamBlocks(n_bits, block_size) * block_size - n_bits);
+}
+
+
+/**
+ * Merges the last incomplete element of every section to the element it shares with the next section and pads the
+ * stream with 0 bits to a whole block. It is called after every section is written to the file.
+ *
+ * @param file        The compressed file (opened for reading and writing)
+ * @param data_start  The offset of the stream in the file
+ * @param sections    The written sections in the order of the file
+ * @param n_sections  The number of sections
+ * @param block_size  The size of a block in bits
+ */
+void writeStreamTails(FILE *file, uint64_t data_start, const StreamSection *sections, int n_sections,
+                      uint32_t block_size) {
+    // The tail waiting for the element of the next section. A section always starts in the element of the previous tail
+    uint64_t tail[2] = {0, 0};
+    uint64_t end_bit = 0;
+
+    for (int i = 0; i < n_sections; ++i) {
+        const StreamSection &section = sections[i];
+
+        if (section.n_bits == 0) {
+            continue;
+        }
+
+        uint64_t first_element = section.start_bit / ELEMENT_BITS;
+        uint64_t last_element = (section.start_bit + section.n_bits) / ELEMENT_BITS;
+
+        if (last_element == first_element) {
+            // The section ends in its first element, which was not written
+            tail[0] |= section.tail[0];
+            tail[1] |= section.tail[1];
+
+        } else {
+            // The writer of the section wrote its first element with the bits of the previous section set to 0
+            if (tail[0] != 0 || tail[1] != 0) {
+                uint64_t element[2] = {0, 0};
+
+                fseek(file, (long) (data_start + first_element * (ELEMENT_BITS / 8)), SEEK_SET);
+                fread(element, sizeof(element[0]), 2, file);
+
+                element[0] |= tail[0];
+                element[1] |= tail[1];
+
+                fseek(file, (long) (data_start + first_element * (ELEMENT_BITS / 8)), SEEK_SET);
+                fwrite(element, sizeof(element[0]), 2, file);
+            }
+
+            tail[0] = section.tail[0];
+            tail[1] = section.tail[1];
+        }
+
+        end_bit = section.start_bit + section.n_bits;
+    }
+
+    // The last tail and the padding of the last block
+    uint64_t n_elements = end_bit / ELEMENT_BITS;
+    uint64_t padded_elements = streamBlocks(end_bit, block_size) * (block_size / ELEMENT_BITS);
+
+    fseek(file, (long) (data_start + n_elements * (ELEMENT_BITS / 8)), SEEK_SET);
+
+    if (end_bit % ELEMENT_BITS != 0) {
+        fwrite(tail, sizeof(tail[0]), 2, file);
+        n_elements++;
+    }
+
+    uint64_t zeros[2] = {0, 0};
+
+    for (; n_elements < padded_elements; ++n_elements) {
+        fwrite(zeros, sizeof(zeros[0]), 2, file);
+    }
+
+#ifdef DEBUG_MODE
+    std::cout << "Stream of " << end_bit << " bits padded to " << padded_elements << " elements" << std::endl;
+#endif
+}
@@ -0,0 +1,99 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdio>
+
+#include "structs.h"
+
+/*
+ * The contiguous stream (CONTIGUOUS_STREAM) of the pthread and cilk compressors. The number of bits of every section
+ * is known from the section frequencies before anything is encoded, so the sections are placed back to back in the
+ * stream (placeStreamSections) and only the end of the stream is padded to a whole block. The compressed data is the
+ * same bit stream the sequential compressor creates and it does not depend on the number of sections.
+ *
+ * Every section is encoded by its own writer starting at its exact bit (offsetBitWriter). A section shares its first
+ * 128 bit element with the end of the previous section. The writer of a section writes its first element (the bits of
+ * the previous section are 0) and keeps its last incomplete element (closeBitWriterTail). When all the sections are
+ * written the kept elements are ORed to the shared elements of the file (writeStreamTails).
+ *
+ * Every stream is planned before it is written, also the padded streams of the sequential compressor and of the
+ * sections. The exact number of bits of a stream is known from the exact frequencies of its characters (streamBits),
+ * so its blocks and its padding are written to the header once and the header is never patched. A stored stream
+ * (STORED_SECTIONS) is planned the same way from the 8 bits of every character.
+ */
+
+
+typedef struct stream_section {
+    uint64_t start_bit = 0;      /// The first bit of the section in the stream
+    uint64_t n_bits = 0;         /// The number of bits of the section
+    uint64_t tail[2] = {0, 0};   /// The last incomplete element of the section (closeBitWriterTail)
+} StreamSection;
+
+
+/**
+ * Returns the exact number of bits of the stream of a file or a section: the symbols of its characters and the frame
+ * headers of the lanes (INTERLEAVED_LANES)
+ *
+ * @param frequencies  The exact frequencies of the characters (256 elements)
+ * @param huffman      The huffman struct with the symbols
+ * @return             The number of bits of the stream
+ */
+uint64_t streamBits(const uint64_t *frequencies, const ASCIIHuffman *huffman);
+
+
+/**
+ * Returns whether a file or a section is stored (STORED_SECTIONS). It is stored if the symbols of its characters and
+ * the table only it needs would not make it smaller, then its stream is its 8 x n characters as they are.
+ *
+ * @param frequencies  The frequencies of the characters (256 elements)
+ * @param huffman      The huffman struct with the symbols
+ * @param table_bits   The bits of the table that is written only if the stream is encoded (0 for a shared table)
+ * @return             True if the characters are stored instead of encoded
+ */
+bool storedStream(const uint64_t *frequencies, const ASCIIHuffman *huffman, uint64_t table_bits);
+
+
+/**
+ * Places the sections back to back in the stream. The n_bits of every section must be set.
+ *
+ * @param sections    The sections in the order of the file
+ * @param n_sections  The number of sections
+ * @return            The number of bits of the stream
+ */
+uint64_t placeStreamSections(StreamSection *sections, int n_sections);
+
+
+/**
+ * Returns the number of blocks of a stream. The last block is padded with 0 bits.
+ *
+ * @param n_bits      The number of bits of the stream
+ * @param block_size  The size of a block in bits
+ * @return            The number of blocks
+ */
+uint64_t streamBlocks(uint64_t n_bits, uint32_t block_size);
+
+
+/**
+ * Returns the number of padding bits of the last block of a stream
+ *
+ * @param n_bits      The number of bits of the stream
+ * @param block_size  The size of a block in bits
+ * @return            The number of padding bits
+ */
+uint32_t streamPadding(uint64_t n_bits, uint32_t block_size);
+
+
+/**
+ * Merges the last incomplete element of every section to the element it shares with the next section and pads the
+ * stream with 0 bits to a whole block. It is called after every section is written to the file.
+ *
+ * @param file        The compressed file (opened for reading and writing)
+ * @param data_start  The offset of the stream in the file
+ * @param sections    The written sections in the order of the file
+ * @param n_sections  The number of sections
+ * @param block_size  The size of a block in bits
+ */
+void writeStreamTails(FILE *file, uint64_t data_start, const StreamSection *sections, int n_sections,
+                      uint32_t block_size);
+
+#endif
@@ -8,28 +8,189 @@
 #define N_THREADS 16
 #define CILK_JOBS N_THREADS
 
+/*
+ * Sampling mode of the sequential compressor. When SAMPLE_FREQUENCIES is defined the frequencies are estimated from
+ * strided chunks of the input file instead of a full pass. The sample is doubled until the estimated bits per byte
+ * changes less than SAMPLE_TOLERANCE (relative).
+ */
+//#define SAMPLE_FREQUENCIES
+#define SAMPLE_CHUNK_SIZE (64 * 1024)  // The size of every sampled chunk in bytes
+#define SAMPLE_FIRST_CHUNKS 16         // The number of chunks of the first sampling round
+#define SAMPLE_TOLERANCE 0.002         // The relative change of the estimated cost that stops the sampling
+
+/*
+ * When FREQUENCY_CACHE is defined the frequencies of the input file are stored in a sidecar file (input + ".freq").
+ * The next run on the same file loads them and skips the frequency pass. See freq_cache.h for the validation key.
+ */
+//#define FREQUENCY_CACHE
+
+/*
+ * When FUSED_MODE is defined the file is compressed in a single pass. Every FUSED_CHUNK_SIZE chunk is counted, gets its
+ * own huffman table and is encoded while it is still in the cache, so the input is read once instead of twice. See
+ * fused.h for the format of the compressed file.
+ */
+//#define FUSED_MODE
+#define FUSED_CHUNK_SIZE (1024 * 1024)  // The number of characters of every chunk
+
+/*
+ * When TABLE_REUSE is defined a fused mode chunk keeps the table of the previous chunk unless its histogram drifted:
+ * the bits per character the current table costs above the entropy of the chunk grew by more than
+ * TABLE_DRIFT_THRESHOLD since the table was built (see tableDrifted). The chunks that keep the table store no table.
+ */
+//#define TABLE_REUSE
+#define TABLE_DRIFT_THRESHOLD 0.02  // The drift in bits per character that rebuilds the table
+
+/*
+ * When SPARSE_FILES is defined only the data extents of the input file (lseek SEEK_DATA/SEEK_HOLE) are counted and
+ * compressed. The holes are stored as an extent map and recreated by the decompressor. See sparse.h.
+ */
+//#define SPARSE_FILES
+
+/*
+ * When LENGTH_LIMITED_CODES is defined the symbols are created with the package-merge algorithm instead of the huffman
+ * tree. No symbol is longer than MAX_CODE_LENGTH bits (at least 8 bits are needed for the 256 characters) and the
+ * symbols are canonical (the symbols of the same length are consecutive numbers ordered by character).
+ */
+//#define LENGTH_LIMITED_CODES
+#define MAX_CODE_LENGTH 12  // The maximum length of a symbol in bits
+
+/*
+ * The symbols are always canonical. When CANONICAL_TABLES is defined the compressed files store only the symbol
+ * lengths (TABLE_CANONICAL, a few hundred bytes instead of HUFFMAN_TABLE_SIZE). The decompressors read every table
+ * kind regardless of this flag.
+ */
+//#define CANONICAL_TABLES
+
+/*
+ * When SECTION_TABLES is defined every section of the pthread and cilk compressors can have its own huffman table. The
+ * table of a section is created from the section frequencies and it is stored only if it saves more bytes than its
+ * size (see chooseSectionTable). The other sections use the global table.
+ */
+//#define SECTION_TABLES
+
+/*
+ * When TABLE_PRESET is defined the compressors use a table preset (see presets.h) instead of the table of the file. It
+ * is the name of a built in preset ("json", "csv" or "protobuf") or of a stored preset file. The sequential compressor
+ * skips the frequency pass, the pthread and cilk compressors still count the sections to place them in the file.
+ */
+//#define TABLE_PRESET "json"
+
+/*
+ * When PAIR_ENCODING is defined the compressors encode two characters with one lookup in a table of the concatenated
+ * symbols of every pair of characters. The pairs that are too long for the table are encoded one character at a time
+ * (see buildPairCodes).
+ */
+//#define PAIR_ENCODING
+
+/*
+ * When CONTIGUOUS_STREAM is defined the sections of the pthread and cilk compressors are not padded to whole blocks.
+ * The exact number of bits of every section is known from the section frequencies, so every section is written at the
+ * bit where the previous one ends and only the end of the stream is padded. The compressed data is the bit stream of
+ * the sequential compressor and does not depend on N_THREADS (see stream.h).
+ */
+//#define CONTIGUOUS_STREAM
+
+/*
+ * When INTERLEAVED_LANES is defined the characters of every file or section are dealt round robin to that many lanes
+ * and every lane is a separate bit stream (see lanes.h). The decompressors decode one symbol of every lane per round,
+ * so the decoding of the lanes overlaps in the cpu. The lanes are encoded with the scalar writer (no PAIR_ENCODING or
+ * vector kernel).
+ */
+//#define INTERLEAVED_LANES 4
+
+/*
+ * When STORED_SECTIONS is defined a file (sequential) or a section (pthread and cilk) whose symbols would not make it
+ * smaller than its characters is stored: its characters are copied to the compressed file as they are and padded to a
+ * whole block (see storedStream). The decompressors copy a stored file or section to the decompressed file
+ * (copy_file_range) instead of decoding it, so incompressible data is never expanded.
+ */
+//#define STORED_SECTIONS
+
+/*
+ * When TABLE_DECODING is defined the decompressors decode a symbol with one lookup of the next DECODE_TABLE_BITS bits
+ * of the stream in a table of (character, length) entries instead of walking the huffman tree one bit at a time. The
+ * longer symbols continue in second level tables (see decode_table.h). Fused mode still walks the tree. It is defined
+ * by default, comment it out to decode with the tree walk.
+ */
+#define TABLE_DECODING
+#define DECODE_TABLE_BITS 11  // The number of bits of a lookup (the first level table has 2^11 entries)
+
+/*
+ * When MULTI_SYMBOL_DECODING is defined the table decoder (TABLE_DECODING) first looks up the next MULTI_DECODE_BITS
+ * bits in a table whose entries hold all the symbols (up to 4) that fit in them, so a lookup decodes several characters
+ * of a stream with short symbols. The lanes (INTERLEAVED_LANES) still decode one symbol per lookup. It is defined by
+ * default and has no effect without TABLE_DECODING, comment it out to decode one symbol per lookup.
+ */
+#define MULTI_SYMBOL_DECODING
+#define MULTI_DECODE_BITS 12  // The number of bits of a multi symbol lookup (the table has 2^12 entries)
+
+#if defined(SPARSE_FILES) && defined(FUSED_MODE)
+#error "SPARSE_FILES is not supported in FUSED_MODE"
+#endif
+
+#if defined(CONTIGUOUS_STREAM) && defined(FUSED_MODE)
+#error "CONTIGUOUS_STREAM is not supported in FUSED_MODE"
+#endif
+
+#if defined(INTERLEAVED_LANES) && defined(FUSED_MODE)
+#error "INTERLEAVED_LANES is not supported in FUSED_MODE"
+#endif
+
+#if defined(INTERLEAVED_LANES) && (INTERLEAVED_LANES < 2 || INTERLEAVED_LANES > 16)
+#error "INTERLEAVED_LANES must be between 2 and 16"
+#endif
+
+#if defined(STORED_SECTIONS) && defined(FUSED_MODE)
+#error "STORED_SECTIONS is not supported in FUSED_MODE"
+#endif
+
+#if defined(STORED_SECTIONS) && defined(CONTIGUOUS_STREAM)
+#error "STORED_SECTIONS is not supported with CONTIGUOUS_STREAM"
+#endif
+
+#if defined(TABLE_DECODING) && (DECODE_TABLE_BITS < 1 || DECODE_TABLE_BITS > 15)
+#error "DECODE_TABLE_BITS must be between 1 and 15"
+#endif
+
+#if defined(MULTI_SYMBOL_DECODING) && (MULTI_DECODE_BITS < 1 || MULTI_DECODE_BITS > 20)
+#error "MULTI_DECODE_BITS must be between 1 and 20"
+#endif
+
+#if defined(TABLE_PRESET) && defined(FUSED_MODE)
+#error "TABLE_PRESET is not supported in FUSED_MODE"
+#endif
+
+#if defined(LENGTH_LIMITED_CODES) && (MAX_CODE_LENGTH < 8 || MAX_CODE_LENGTH > 255)
+#error "MAX_CODE_LENGTH must be between 8 and 255"
+#endif
+
 
 /**
- * This is a single symbol for an ascii character. Every character is 4bits long. That means there are 16 different
- * characters. This leads to huffman symbols with with max length of 15 bits.
+ * This is a single symbol for an ascii character. The code word type holds the bits of the symbol. The huffman table
+ * is built and stored with uint256_t code words (Symbol) because a symbol of the unconstrained tree can be up to 255
+ * bits long. The encoders and decoders use the narrowest code word that fits the longest symbol of the table
+ * (uint32_t, uint64_t or the uint256_t fallback, see codeWordWidth).
  */
-typedef struct symbol {
+template <typename CodeWord>
+struct SymbolT {
     /**
-     * The huffman symbol of every character. The symbols are created from the bottom to the top of the tree. As a
-     * result first bit of the symbol is added last so it can be found at the LSB of the 16 bit number.
+     * The huffman symbol of every character. The symbols are created from the top to the bottom of the tree. As a
+     * result the first bit of the symbol is the MSB of the symbol_length bit number.
      *
      *      eg
-     *          uint16_t symbol: 0000 0010 1010 1011
+     *          uint16_t symbol: 0000 0011 0101 0101
      *          symbol length: 10
      *
      *          To reach the leaf node from the root node we take this path 1, 1, 0, 1, 0, 1, 0, 1, 0, 1
      */
-    uint256_t symbol;
+    CodeWord symbol;
 
     /// The symbol length measured in bits
     uint8_t symbol_length;
 
-} Symbol;
+};
+
+typedef SymbolT<uint256_t> Symbol;
 
 
 /**
@@ -54,15 +215,29 @@ typedef struct ascii_huffman {
      */
     uint64_t frequencies[N_THREADS][256];
 
+    /**
+     * The id of the shared table the symbols belong to (batch mode). If it is not 0 the compressed files store only a
+     * reference to the shared table
+     */
+    uint64_t table_id = 0;
+
+    /**
+     * The id of the built in table preset the symbols belong to (TABLE_PRESET). If it is not 0 the compressed files
+     * store only the id of the preset
+     */
+    uint8_t preset_id = 0;
+
 } ASCIIHuffman;
 
 
 /**
- * The huffman_node struct represent a node in the huffman tree. The node can be a leaf node or a regular node
+ * The huffman_node struct represent a node in the huffman tree. The node can be a leaf node or a regular node. The
+ * decoders copy a node for every bit, so they use the node with the narrowest code word of the table.
  *
  */
-typedef struct huffman_node{
-    Symbol leaf_symbol;  /// The huffman symbol
+template <typename CodeWord>
+struct HuffmanNodeT {
+    SymbolT<CodeWord> leaf_symbol;  /// The huffman symbol
     uint8_t ascii_index;  /// The ascii char
     unsigned long int freq;  /// The frequency of the character
 
@@ -72,6 +247,8 @@ typedef struct huffman_node{
     uint16_t left;  /// The index of the left child of the node (-1 if there are no children)
     uint16_t right;  /// The index of the right child of the node (-1 if there are no children)
 
-} HuffmanNode;
+};
+
+typedef HuffmanNodeT<uint256_t> HuffmanNode;
 
 #endif //STRUCTS_H
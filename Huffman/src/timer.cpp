@@ -73,4 +73,21 @@ void displayElapsed(Timer *timer) {
 
     std::cout << timer->elapsed_sec << "s " << timer->elapsed_ms << "ms " << timer->elapsed_us
               << "us " << timer->elapsed_ns << "ns\n" << std::endl;
-}
\ No newline at end of file
+}
+
+/**
+ * Print the throughput achieved while processing a number of bytes in the elapsed time of the timer
+ * @param timer  The timer struct
+ * @param bytes  The number of bytes processed
+ */
+void displayThroughput(Timer *timer, uint64_t bytes) {
+    // The elapsed time in seconds
+    double seconds = (double) timer->elapsed_sec + (double) timer->elapsed_ms / 1e3 +
+                     (double) timer->elapsed_us / 1e6 + (double) timer->elapsed_ns / 1e9;
+
+    if (seconds == 0) {
+        return;
+    }
+
+    std::cout << "Throughput: " << (double) bytes / seconds / 1e9 << " GB/s\n" << std::endl;
+}
@@ -1,6 +1,7 @@
 #ifndef HUFFMAN_TIMER_H
 #define HUFFMAN_TIMER_H
 
+#include <cinttypes>
 #include <sys/time.h>
 
 typedef struct timer{
@@ -34,4 +35,12 @@ void stopTimer(Timer *timer);
  */
 void displayElapsed(Timer *timer);
 
+
+/**
+ * Print the throughput achieved while processing a number of bytes in the elapsed time of the timer
+ * @param timer  The timer struct
+ * @param bytes  The number of bytes processed
+ */
+void displayThroughput(Timer *timer, uint64_t bytes);
+
 #endif
@@ -0,0 +1,201 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../src/structs.h"
+#include "../src/huffman.h"
+#include "../src/bit_writer.h"
+
+using namespace std;
+
+/*
+ * Round trip of the encode kernels on a table with VECTOR_CODE_MAX_LENGTH (16) bit symbols. The 8 common characters
+ * have the frequencies 2^17 to 2^10 and the 248 rare ones appear once, so the rare characters get 15 and 16 bit
+ * symbols and a group of 8 rare characters is two quads of up to 64 bits. The buffer is encoded with the vector kernel
+ * of the cpu and with the scalar writer, the two streams must be equal and the stream must decode to the buffer.
+ */
+
+#define N_COMMON 8        // The number of common characters
+#define N_RARE_RUNS 4096  // The number of runs of the rare characters at the start of the buffer
+
+
+/**
+ * Creates the test buffer: runs of the rare characters followed by the common characters in a pseudo random order
+ *
+ * @param length   The number of characters of the buffer
+ * @param huffman  The huffman struct the frequencies of the table are stored to
+ * @return         The buffer (free it)
+ */
+static uint8_t *createBuffer(uint64_t *length, ASCIIHuffman *huffman) {
+    uint64_t n_common = 0;
+
+    for (int c = 0; c < N_COMMON; ++c) {
+        n_common += 131072 >> c;
+    }
+
+    uint64_t n_rare = N_RARE_RUNS * (256 - N_COMMON);
+
+    *length = n_rare + n_common;
+    auto *data = (uint8_t *) malloc(*length);
+
+    // Every run is the rare characters in order, so every group of 8 of them is encoded with 16 bit symbols
+    for (uint64_t i = 0; i < n_rare; ++i) {
+        data[i] = N_COMMON + i % (256 - N_COMMON);
+    }
+
+    uint64_t i = n_rare;
+
+    for (int c = 0; c < N_COMMON; ++c) {
+        for (uint32_t j = 0; j < (131072U >> c); ++j) {
+            data[i++] = c;
+        }
+    }
+
+    // Shuffle the common characters with a fixed seed
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    for (uint64_t j = *length - 1; j > n_rare; --j) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t k = n_rare + (state >> 33) % (j - n_rare + 1);
+
+        uint8_t temp = data[j];
+        data[j] = data[k];
+        data[k] = temp;
+    }
+
+    // The frequencies of the table. The rare characters are counted once so their symbols are the longest
+    for (int c = 0; c < N_COMMON; ++c) {
+        huffman->charFreq[c] = 131072 >> c;
+    }
+
+    for (int c = N_COMMON; c < 256; ++c) {
+        huffman->charFreq[c] = 1;
+    }
+
+    return data;
+}
+
+
+/**
+ * Encodes a buffer to a buffer of words
+ *
+ * @param data          The characters
+ * @param length        The number of characters
+ * @param symbols       The symbols of the characters
+ * @param vector_codes  The packed symbols or nullptr for the scalar writer
+ * @param n_words       The size of the stream in words
+ * @return              The stream (free it)
+ */
+static uint64_t *encodeBuffer(const uint8_t *data, uint64_t length, const SymbolT<uint32_t> *symbols,
+                              const uint32_t *vector_codes, uint64_t *n_words) {
+    // Up to VECTOR_CODE_MAX_LENGTH bits per character and a spare element
+    uint64_t buffer_words = (length * VECTOR_CODE_MAX_LENGTH / WORD_BITS + 4) & ~1ULL;
+    auto *words = (uint64_t *) calloc(buffer_words, sizeof(uint64_t));
+
+    BitWriter writer;
+    attachBitWriter(&writer, words, buffer_words);
+
+    putBytes(&writer, data, length, symbols, nullptr, vector_codes);
+    closeBitWriter(&writer);
+
+    *n_words = writer.word_index;
+
+    return words;
+}
+
+
+/**
+ * Decodes a stream by walking the huffman tree and compares it with the buffer
+ *
+ * @param words    The stream
+ * @param data     The characters
+ * @param length   The number of characters
+ * @param huffman  The huffman struct with the symbols
+ * @return         The index of the first character that is decoded wrong or length
+ */
+static uint64_t verifyStream(const uint64_t *words, const uint8_t *data, uint64_t length, ASCIIHuffman *huffman) {
+    auto *nodes = (HuffmanNodeT<uint32_t> *) malloc(511 * sizeof(HuffmanNodeT<uint32_t>));
+    uint16_t root_index = huffmanFromArray(huffman, nodes);
+
+    uint64_t position = 0;
+    uint64_t i = 0;
+
+    for (; i < length; ++i) {
+        uint16_t node = root_index;
+
+        do {
+            // Word w of the stream is stored to words[w ^ 1]
+            uint64_t word = words[(position / WORD_BITS) ^ 1];
+            uint64_t bit = (word >> (WORD_BITS - 1 - position % WORD_BITS)) & 1;
+
+            node = bit == 0 ? nodes[node].left : nodes[node].right;
+            ++position;
+        } while (!nodes[node].isLeaf);
+
+        if (nodes[node].ascii_index != data[i]) {
+            break;
+        }
+    }
+
+    free(nodes);
+
+    return i;
+}
+
+
+int main() {
+    ASCIIHuffman huffman;
+
+    uint64_t length;
+    uint8_t *data = createBuffer(&length, &huffman);
+
+    createHuffmanTree(&huffman);
+
+    uint8_t max_length = 0;
+
+    for (Symbol &symbol : huffman.symbols) {
+        max_length = symbol.symbol_length > max_length ? symbol.symbol_length : max_length;
+    }
+
+    uint32_t vector_codes[256];
+
+    if (max_length != VECTOR_CODE_MAX_LENGTH || !buildVectorCodes(&huffman, vector_codes)) {
+        cout << "The test table has " << unsigned(max_length) << " bit symbols instead of " << VECTOR_CODE_MAX_LENGTH
+             << endl;
+        return -1;
+    }
+
+    SymbolT<uint32_t> symbols[256];
+    narrowSymbols(&huffman, symbols);
+
+    uint64_t vector_words;
+    uint64_t scalar_words;
+    uint64_t *vector_stream = encodeBuffer(data, length, symbols, vector_codes, &vector_words);
+    uint64_t *scalar_stream = encodeBuffer(data, length, symbols, nullptr, &scalar_words);
+
+    cout << "Encoded " << length << " characters with the " << encodeKernelName() << " kernel" << endl;
+
+    int result = 0;
+
+    if (vector_words != scalar_words || memcmp(vector_stream, scalar_stream, vector_words * sizeof(uint64_t)) != 0) {
+        cout << "The " << encodeKernelName() << " kernel stream differs from the scalar stream" << endl;
+        result = -1;
+    }
+
+    uint64_t decoded = verifyStream(vector_stream, data, length, &huffman);
+
+    if (decoded != length) {
+        cout << "The " << encodeKernelName() << " kernel stream decodes wrong at character " << decoded << endl;
+        result = -1;
+    }
+
+    if (result == 0) {
+        cout << "ENCODE KERNEL TEST PASS" << endl;
+    }
+
+    free(vector_stream);
+    free(scalar_stream);
+    free(data);
+
+    return result;
+}